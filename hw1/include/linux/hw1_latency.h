@@ -0,0 +1,46 @@
+#ifndef _LINUX_HW1_LATENCY_H
+#define _LINUX_HW1_LATENCY_H
+
+#include <linux/types.h>
+#include <linux/sched.h>
+
+/*
+ * log2 latency histograms of the hw1 syscalls, read from
+ * /sys/kernel/debug/hw1/ once recording is switched on by writing 1 to
+ * /sys/kernel/debug/hw1/enable. Compiled out without CONFIG_DEBUG_FS.
+ */
+enum hw1_latency_site {
+	HW1_LATENCY_UNIQUE_ID,		/* sys_get_unique_id */
+	HW1_LATENCY_CHILD_PIDS,		/* sys_get_child_pids */
+	HW1_LATENCY_CHILD_WALK,		/* RCU read side of the child walk */
+	HW1_LATENCY_NR,
+};
+
+#ifdef CONFIG_DEBUG_FS
+extern u32 hw1_latency_enabled;
+
+void hw1_latency_record(enum hw1_latency_site site, u64 ns, long ret);
+
+/* Returns 0 when recording is off, hw1_latency_end then does nothing */
+static inline u64 hw1_latency_start(void)
+{
+	return ACCESS_ONCE(hw1_latency_enabled) ? local_clock() : 0;
+}
+
+static inline void hw1_latency_end(enum hw1_latency_site site, u64 start, long ret)
+{
+	if (start != 0)
+		hw1_latency_record(site, local_clock() - start, ret);
+}
+#else
+static inline u64 hw1_latency_start(void)
+{
+	return 0;
+}
+
+static inline void hw1_latency_end(enum hw1_latency_site site, u64 start, long ret)
+{
+}
+#endif
+
+#endif /* _LINUX_HW1_LATENCY_H */
@@ -65,6 +65,9 @@ struct old_linux_dirent;
 struct perf_event_attr;
 struct file_handle;
 struct sigaltstack;
+struct child_tree_entry;
+struct child_info;
+struct child_filter;
 union bpf_attr;
 
 #include <linux/types.h>
@@ -878,6 +881,27 @@ asmlinkage long sys_getrandom(char __user *buf, size_t count,
 			      unsigned int flags);
 asmlinkage long sys_bpf(int cmd, union bpf_attr *attr, unsigned int size);
 asmlinkage long sys_get_unique_id(int *uuid);
+asmlinkage long sys_get_unique_id_range(int *base, unsigned int count);
+asmlinkage long sys_get_unique_id64(u64 __user *base, unsigned int count,
+				    unsigned int flags);
 asmlinkage long sys_get_child_pids(pid_t* list, size_t limit, size_t* num_children);
+asmlinkage long sys_get_child_pids_cursor(pid_t __user *list, size_t limit,
+					  pid_t __user *cursor);
+asmlinkage long sys_get_child_tree(pid_t pid, struct child_tree_entry __user *list,
+				   size_t limit, size_t __user *num_entries,
+				   unsigned int max_depth);
+asmlinkage long sys_get_child_info(struct child_info __user *list, size_t limit,
+				   size_t __user *num_children);
+asmlinkage long sys_child_watch_open(pid_t pid, unsigned int flags);
+asmlinkage long sys_get_child_pids_filter(pid_t __user *list, size_t limit,
+					  size_t __user *num_children,
+					  const struct child_filter __user *ufilter);
+asmlinkage long sys_get_child_pids_batch(const pid_t __user *parents,
+					 size_t nr_parents, pid_t __user *list,
+					 size_t limit, size_t __user *offsets);
+asmlinkage long sys_get_child_pidfds(int __user *fds, size_t limit,
+				     size_t __user *num_children, unsigned int flags);
+asmlinkage long sys_get_thread_tids(pid_t pid, pid_t __user *list, size_t limit,
+				    size_t __user *num_threads);
 #endif
 
@@ -0,0 +1,146 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM hw1
+
+#if !defined(_TRACE_HW1_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_HW1_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * Entry and exit of sys_get_unique_id and sys_get_child_pids, plus the
+ * points where they touch shared state: the refill of a per-CPU ID chunk
+ * from the global counter, and the RCU read side of the child walk.
+ */
+
+TRACE_EVENT(unique_id_enter,
+
+	TP_PROTO(unsigned int count),
+
+	TP_ARGS(count),
+
+	TP_STRUCT__entry(
+		__field(	unsigned int,	count	)
+	),
+
+	TP_fast_assign(
+		__entry->count	= count;
+	),
+
+	TP_printk("count=%u", __entry->count)
+);
+
+TRACE_EVENT(unique_id_refill,
+
+	TP_PROTO(u64 first, unsigned int count),
+
+	TP_ARGS(first, count),
+
+	TP_STRUCT__entry(
+		__field(	u64,		first	)
+		__field(	unsigned int,	count	)
+	),
+
+	TP_fast_assign(
+		__entry->first	= first;
+		__entry->count	= count;
+	),
+
+	TP_printk("first=%llu count=%u",
+		  (unsigned long long)__entry->first, __entry->count)
+);
+
+TRACE_EVENT(unique_id_exit,
+
+	TP_PROTO(long ret, u64 first),
+
+	TP_ARGS(ret, first),
+
+	TP_STRUCT__entry(
+		__field(	long,		ret	)
+		__field(	u64,		first	)
+	),
+
+	TP_fast_assign(
+		__entry->ret	= ret;
+		__entry->first	= first;
+	),
+
+	TP_printk("ret=%ld first=%llu",
+		  __entry->ret, (unsigned long long)__entry->first)
+);
+
+TRACE_EVENT(child_pids_enter,
+
+	TP_PROTO(size_t limit),
+
+	TP_ARGS(limit),
+
+	TP_STRUCT__entry(
+		__field(	size_t,		limit	)
+	),
+
+	TP_fast_assign(
+		__entry->limit	= limit;
+	),
+
+	TP_printk("limit=%zu", __entry->limit)
+);
+
+/* The walk runs under rcu_read_lock, in place of tasklist_lock */
+TRACE_EVENT(child_pids_walk_begin,
+
+	TP_PROTO(size_t stage_nr),
+
+	TP_ARGS(stage_nr),
+
+	TP_STRUCT__entry(
+		__field(	size_t,		stage_nr	)
+	),
+
+	TP_fast_assign(
+		__entry->stage_nr	= stage_nr;
+	),
+
+	TP_printk("stage_nr=%zu", __entry->stage_nr)
+);
+
+TRACE_EVENT(child_pids_walk_end,
+
+	TP_PROTO(size_t nb_children),
+
+	TP_ARGS(nb_children),
+
+	TP_STRUCT__entry(
+		__field(	size_t,		nb_children	)
+	),
+
+	TP_fast_assign(
+		__entry->nb_children	= nb_children;
+	),
+
+	TP_printk("nb_children=%zu", __entry->nb_children)
+);
+
+TRACE_EVENT(child_pids_exit,
+
+	TP_PROTO(long ret, size_t nb_children),
+
+	TP_ARGS(ret, nb_children),
+
+	TP_STRUCT__entry(
+		__field(	long,		ret		)
+		__field(	size_t,		nb_children	)
+	),
+
+	TP_fast_assign(
+		__entry->ret		= ret;
+		__entry->nb_children	= nb_children;
+	),
+
+	TP_printk("ret=%ld nb_children=%zu", __entry->ret, __entry->nb_children)
+);
+
+#endif /* _TRACE_HW1_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
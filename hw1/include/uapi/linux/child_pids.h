@@ -0,0 +1,59 @@
+#ifndef _UAPI_LINUX_CHILD_PIDS_H
+#define _UAPI_LINUX_CHILD_PIDS_H
+
+#include <linux/types.h>
+
+/*
+ * One node of the descendant tree returned by sys_get_child_tree.
+ * Nodes are in BFS order; the root is entry 0 with parent_index -1.
+ */
+struct child_tree_entry {
+	__s32 pid;
+	__s32 parent_index;	/* index of the parent entry in the array */
+	__u32 depth;		/* 0 for the root */
+};
+
+/*
+ * Per-child record returned by sys_get_child_info.
+ */
+struct child_info {
+	__s32 pid;
+	__u32 state;		/* task state | exit state, TASK_* / EXIT_* */
+	__s32 cpu;		/* CPU the child last ran on */
+	__u32 nr_threads;
+	__u64 utime;		/* user time of the thread group, in ns */
+	__u64 stime;		/* system time of the thread group, in ns */
+	__u64 rss;		/* resident set size, in pages */
+};
+
+/*
+ * Filter applied by sys_get_child_pids_filter. A child is returned when
+ * it matches every non-empty field.
+ */
+#define CHILD_FILTER_RUNNING	0x01	/* running or runnable */
+#define CHILD_FILTER_SLEEPING	0x02	/* interruptible sleep */
+#define CHILD_FILTER_DISK	0x04	/* uninterruptible sleep */
+#define CHILD_FILTER_STOPPED	0x08	/* stopped or traced */
+#define CHILD_FILTER_ZOMBIE	0x10	/* exited, waiting to be reaped */
+#define CHILD_FILTER_ALL	0x1f
+
+struct child_filter {
+	__u32 state_mask;	/* CHILD_FILTER_* bits, 0 for any state */
+	__u32 pad;
+	__u64 min_start_time;	/* ns since boot, 0 for any */
+	char comm_prefix[16];	/* empty for any command name */
+};
+
+/*
+ * Change reported by a sys_child_watch_open descriptor.
+ */
+#define CHILD_EVENT_ADDED	1	/* pid was forked */
+#define CHILD_EVENT_REMOVED	2	/* pid exited */
+#define CHILD_EVENT_OVERFLOW	3	/* events were lost, pid is 0 */
+
+struct child_event {
+	__s32 pid;
+	__u32 type;
+};
+
+#endif /* _UAPI_LINUX_CHILD_PIDS_H */
@@ -0,0 +1,17 @@
+#ifndef _UAPI_LINUX_UNIQUE_ID_H
+#define _UAPI_LINUX_UNIQUE_ID_H
+
+/*
+ * Flags of sys_get_unique_id64.
+ *
+ * UNIQUE_ID_SNOWFLAKE returns time ordered IDs instead of counter values:
+ * bit 63 is 0, then 41 bits of milliseconds since UNIQUE_ID_EPOCH_MS
+ * (wall clock), 10 bits of CPU number and 12 bits of per-CPU sequence.
+ */
+#define UNIQUE_ID_SNOWFLAKE	0x1
+
+#define UNIQUE_ID_EPOCH_MS	1420070400000ULL /* 2015-01-01 00:00:00 UTC */
+#define UNIQUE_ID_CPU_BITS	10
+#define UNIQUE_ID_SEQ_BITS	12
+
+#endif /* _UAPI_LINUX_UNIQUE_ID_H */
@@ -0,0 +1,294 @@
+#include <linux/linkage.h>
+#include <linux/uaccess.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/anon_inodes.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/hashtable.h>
+#include <linux/ptrace.h>
+#include <linux/pid_namespace.h>
+#include <linux/child_pids.h>
+#include <trace/events/sched.h>
+
+/*
+ * Pollable child-change notifications. A watch is an anon inode fd bound
+ * to one parent; it becomes readable when a child of that parent is forked
+ * or exits and read() returns the changes as struct child_event records.
+ * Fork and exit are observed through the sched_process_fork/exit
+ * tracepoints, so the feature needs CONFIG_TRACEPOINTS. PIDs are reported
+ * as seen from the pid namespace of the process that opened the watch,
+ * like the other child APIs; children not visible there are skipped.
+ */
+
+/* Events buffered per watch, must be a power of 2 */
+#define CHILD_WATCH_RING	256
+/* Recently reported exits, to report each dead child only once */
+#define CHILD_WATCH_RECENT	8
+#define CHILD_WATCH_HASH_BITS	6
+
+struct child_watch {
+	struct hlist_node node;		/* in child_watch_table, under RCU */
+	struct rcu_head rcu;
+	struct task_struct *parent;
+	struct pid_namespace *ns;	/* of the opener, PIDs are reported in it */
+	wait_queue_head_t wait;
+	spinlock_t lock;		/* protects everything below */
+	unsigned int head;		/* next slot to fill */
+	unsigned int tail;		/* next slot to read */
+	bool overflow;			/* ring is full, events are dropped */
+	pid_t recent[CHILD_WATCH_RECENT];
+	unsigned int recent_next;
+	struct child_event ring[CHILD_WATCH_RING];
+};
+
+static DEFINE_HASHTABLE(child_watch_table, CHILD_WATCH_HASH_BITS);
+static DEFINE_SPINLOCK(child_watch_table_lock); //only taken by add and remove
+static bool child_watch_enabled;
+
+/* Called with watch->lock held */
+static void child_watch_push(struct child_watch *watch, pid_t pid, unsigned int type)
+{
+	struct child_event *event;
+	unsigned int i;
+
+	if (type == CHILD_EVENT_REMOVED) {
+		//the last threads of a group may exit concurrently
+		for (i = 0; i < CHILD_WATCH_RECENT; i++)
+			if (watch->recent[i] == pid)
+				return;
+		watch->recent[watch->recent_next++ % CHILD_WATCH_RECENT] = pid;
+	} else {
+		//the PID got reused, forget its previous exit
+		for (i = 0; i < CHILD_WATCH_RECENT; i++)
+			if (watch->recent[i] == pid)
+				watch->recent[i] = 0;
+	}
+
+	if (watch->overflow)
+		return;
+	//keep the last slot for the overflow marker
+	if (watch->head - watch->tail == CHILD_WATCH_RING - 1) {
+		watch->overflow = true;
+		pid = 0;
+		type = CHILD_EVENT_OVERFLOW;
+	}
+	event = &watch->ring[watch->head++ & (CHILD_WATCH_RING - 1)];
+	event->pid = pid;
+	event->type = type;
+}
+
+static void child_watch_post(struct task_struct *parent, struct task_struct *child,
+			     unsigned int type)
+{
+	struct child_watch *watch;
+	pid_t pid;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(child_watch_table, watch, node, (unsigned long) parent) {
+		if (watch->parent != parent)
+			continue;
+		pid = task_tgid_nr_ns(child, watch->ns);
+		if (pid == 0)
+			continue;
+		spin_lock(&watch->lock);
+		child_watch_push(watch, pid, type);
+		spin_unlock(&watch->lock);
+		wake_up_interruptible_poll(&watch->wait, POLLIN | POLLRDNORM);
+	}
+	rcu_read_unlock();
+}
+
+static void child_watch_fork(void *data, struct task_struct *parent,
+			     struct task_struct *child)
+{
+	//only thread group leaders are children, and with CLONE_PARENT the
+	//new process belongs to the parent of the caller
+	if (!thread_group_leader(child))
+		return;
+	rcu_read_lock();
+	child_watch_post(rcu_dereference(child->real_parent)->group_leader,
+			 child, CHILD_EVENT_ADDED);
+	rcu_read_unlock();
+}
+
+static void child_watch_exit(void *data, struct task_struct *task)
+{
+	//a process is gone once its last thread exits
+	if (atomic_read(&task->signal->live) != 0)
+		return;
+	rcu_read_lock();
+	child_watch_post(rcu_dereference(task->real_parent)->group_leader,
+			 task, CHILD_EVENT_REMOVED);
+	rcu_read_unlock();
+}
+
+static bool child_watch_pending(struct child_watch *watch)
+{
+	bool pending;
+
+	spin_lock(&watch->lock);
+	pending = watch->head != watch->tail;
+	spin_unlock(&watch->lock);
+
+	return pending;
+}
+
+static void child_watch_free_rcu(struct rcu_head *rcu)
+{
+	struct child_watch *watch = container_of(rcu, struct child_watch, rcu);
+
+	put_pid_ns(watch->ns);
+	kfree(watch);
+}
+
+static void child_watch_free(struct child_watch *watch)
+{
+	spin_lock(&child_watch_table_lock);
+	hash_del_rcu(&watch->node);
+	spin_unlock(&child_watch_table_lock);
+	//probes only compare the parent pointer, the reference can go now,
+	//but they may still look the namespace up until a grace period
+	put_task_struct(watch->parent);
+	call_rcu(&watch->rcu, child_watch_free_rcu);
+}
+
+static int child_watch_release(struct inode *inode, struct file *file)
+{
+	child_watch_free(file->private_data);
+	return 0;
+}
+
+static ssize_t child_watch_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct child_watch *watch = file->private_data;
+	struct child_event events[16];
+	size_t nb_events, copied = 0;
+	int ret;
+
+	if (count < sizeof(struct child_event))
+		return -EINVAL;
+
+	while (!child_watch_pending(watch)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(watch->wait, child_watch_pending(watch));
+		if (ret != 0)
+			return ret;
+	}
+
+	//copy out in small batches so the probes never wait on user memory
+	while (count - copied >= sizeof(struct child_event)) {
+		nb_events = 0;
+		spin_lock(&watch->lock);
+		while (watch->head != watch->tail && nb_events < ARRAY_SIZE(events) &&
+		       (nb_events + 1) * sizeof(struct child_event) <= count - copied) {
+			events[nb_events] = watch->ring[watch->tail++ & (CHILD_WATCH_RING - 1)];
+			if (events[nb_events].type == CHILD_EVENT_OVERFLOW)
+				watch->overflow = false;
+			nb_events++;
+		}
+		spin_unlock(&watch->lock);
+		if (nb_events == 0)
+			break;
+
+		if (copy_to_user(buf + copied, events, nb_events * sizeof(struct child_event)))
+			return copied ? copied : -EFAULT;
+		copied += nb_events * sizeof(struct child_event);
+	}
+
+	return copied;
+}
+
+static unsigned int child_watch_poll(struct file *file, poll_table *wait)
+{
+	struct child_watch *watch = file->private_data;
+
+	poll_wait(file, &watch->wait, wait);
+
+	return child_watch_pending(watch) ? POLLIN | POLLRDNORM : 0;
+}
+
+static const struct file_operations child_watch_fops = {
+	.owner		= THIS_MODULE,
+	.release	= child_watch_release,
+	.read		= child_watch_read,
+	.poll		= child_watch_poll,
+	.llseek		= noop_llseek,
+};
+
+/*
+ * Open a watch on the children of pid (0 for current), forked by any of
+ * its threads. The caller needs ptrace read access to pid. flags may hold
+ * O_CLOEXEC and O_NONBLOCK. Reparenting is not reported; on
+ * CHILD_EVENT_OVERFLOW, or after the watched parent exits or one of its
+ * other threads execs and becomes the leader, resync with
+ * sys_get_child_pids_batch on pid, which matches children on the leader
+ * too. sys_get_child_pids only lists the children of the calling thread.
+ */
+asmlinkage long sys_child_watch_open(pid_t pid, unsigned int flags)
+{
+	struct child_watch *watch;
+	struct task_struct *parent;
+	int fd;
+
+	if (flags & ~(O_CLOEXEC | O_NONBLOCK))
+		return -EINVAL;
+	if (!child_watch_enabled)
+		return -ENOSYS;
+
+	//watches are keyed on the leader, children of every thread are reported
+	rcu_read_lock();
+	parent = pid ? find_task_by_vpid(pid) : current;
+	if (parent != NULL) {
+		parent = parent->group_leader;
+		get_task_struct(parent);
+	}
+	rcu_read_unlock();
+	if (parent == NULL)
+		return -ESRCH;
+	if (!ptrace_may_access(parent, PTRACE_MODE_READ)) {
+		put_task_struct(parent);
+		return -EPERM;
+	}
+
+	watch = kzalloc(sizeof(*watch), GFP_KERNEL);
+	if (watch == NULL) {
+		put_task_struct(parent);
+		return -ENOMEM;
+	}
+	watch->parent = parent;
+	watch->ns = get_pid_ns(task_active_pid_ns(current));
+	init_waitqueue_head(&watch->wait);
+	spin_lock_init(&watch->lock);
+
+	spin_lock(&child_watch_table_lock);
+	hash_add_rcu(child_watch_table, &watch->node, (unsigned long) parent);
+	spin_unlock(&child_watch_table_lock);
+
+	fd = anon_inode_getfd("[child_watch]", &child_watch_fops, watch,
+			      O_RDONLY | flags);
+	if (fd < 0)
+		child_watch_free(watch);
+
+	return fd;
+}
+
+static int __init child_watch_init(void)
+{
+	if (register_trace_sched_process_fork(child_watch_fork, NULL))
+		return 0;
+	if (register_trace_sched_process_exit(child_watch_exit, NULL)) {
+		unregister_trace_sched_process_fork(child_watch_fork, NULL);
+		return 0;
+	}
+	child_watch_enabled = true;
+	return 0;
+}
+late_initcall(child_watch_init);
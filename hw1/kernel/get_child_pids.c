@@ -1,33 +1,1027 @@
 #include <linux/linkage.h>
 #include <linux/uaccess.h>
-#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/init.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+#include <linux/sort.h>
+#include <linux/bsearch.h>
+#include <linux/child_pids.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/ptrace.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/anon_inodes.h>
+#include <linux/seq_file.h>
+#include <linux/poll.h>
+#include <linux/hw1_latency.h>
+#include <trace/events/hw1.h>
+#include <trace/events/sched.h>
 
-asmlinkage long sys_get_child_pids(pid_t* list, size_t limit,size_t* num_children) {
-	struct task_struct* task = NULL;
-	size_t nb_children = 0;
-	long ret = 0;
-	
-	read_lock (&tasklist_lock);
-	list_for_each_entry(task, &current->children, sibling)
-	{
-		nb_children++;
-		if (nb_children <= limit && limit != 0 && list != NULL) {
-			*list = task->pid;
-			list++; //next elem in the list
-		}
+/*
+ * Results are gathered in a kernel staging buffer during the walk and
+ * copied out with a single copy_to_user once the read side is left, so
+ * the walk itself never touches user memory. Small buffers come from a
+ * dedicated slab cache and bigger ones from kmalloc; vmalloc, with its
+ * page table updates and TLB flushes, is only used for huge families or
+ * when memory is too fragmented for kmalloc.
+ */
+#define CHILD_PIDS_STAGE_SIZE	1024
+/* Largest stage tried with kmalloc first, a costly order allocation */
+#define CHILD_PIDS_STAGE_KMALLOC_MAX	(PAGE_SIZE << PAGE_ALLOC_COSTLY_ORDER)
+/* Headroom for children forked between sizing the buffer and the walk */
+#define CHILD_PIDS_STAGE_SLACK	64
+/* Largest page sys_get_child_pids_cursor returns in one call */
+#define CHILD_PIDS_PAGE_MAX	16384
+/* Most PIDs sys_get_child_pids_cursor looks at in one call */
+#define CHILD_PIDS_CURSOR_SCAN	4096
+/* Most parents sys_get_child_pids_batch takes in one call */
+#define CHILD_PIDS_BATCH_MAX	4096
+
+static struct kmem_cache *child_pids_stage_cachep;
+
+static int __init child_pids_init(void)
+{
+	child_pids_stage_cachep = kmem_cache_create("child_pids_stage",
+			CHILD_PIDS_STAGE_SIZE, 0, SLAB_PANIC, NULL);
+	return 0;
+}
+core_initcall(child_pids_init);
+
+static void *child_pids_stage_alloc(size_t size)
+{
+	void *stage;
+
+	if (size <= CHILD_PIDS_STAGE_SIZE)
+		return kmem_cache_alloc(child_pids_stage_cachep, GFP_KERNEL);
+	if (size <= CHILD_PIDS_STAGE_KMALLOC_MAX) {
+		stage = kmalloc(size, GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY);
+		if (stage != NULL)
+			return stage;
+	}
+	return vmalloc(size);
+}
+
+static void child_pids_stage_free(void *stage, size_t size)
+{
+	if (stage == NULL)
+		return;
+	if (size <= CHILD_PIDS_STAGE_SIZE)
+		kmem_cache_free(child_pids_stage_cachep, stage);
+	else
+		kvfree(stage); //kmalloc or vmalloc, whichever succeeded
+}
+
+/*
+ * One walk over a set of tasks, the children of current unless iterate()
+ * says otherwise. iterate() runs under rcu_read_lock and hands each task
+ * to child_walk_visit(). Every task accepted by match() (all of them if
+ * it is NULL) is counted and, while there is room, recorded by fill() in
+ * the staging buffer, whose entries are size bytes each. drop(), if set,
+ * releases what fill() took when entries are thrown away.
+ */
+struct child_walk {
+	size_t size;
+	long (*iterate)(struct child_walk *walk);
+	void (*fill)(void *entry, struct task_struct *task);
+	void (*drop)(void *entry);
+	bool (*match)(struct task_struct *task, const void *arg);
+	const void *arg;
+	void *stage;
+	size_t stage_nr;	/* entries the stage can hold */
+	size_t nb_children;	/* children seen by the walk */
+	pid_t root;		/* child_walk_threads: whose threads, 0 for current */
+};
+
+static void child_walk_visit(struct child_walk *walk, struct task_struct *task)
+{
+	if (walk->match != NULL && !walk->match(task, walk->arg))
+		return;
+	if (walk->nb_children < walk->stage_nr)
+		walk->fill((char *) walk->stage + walk->nb_children * walk->size, task);
+	walk->nb_children++;
+}
+
+/*
+ * current->children is only stable under tasklist_lock, which every fork
+ * and exit takes for writing. Walk the RCU protected process list instead
+ * and pick the processes whose real_parent is current: the same set, since
+ * only thread group leaders are linked on a children list. Monitoring
+ * never holds up process creation; a child forked or reaped during the
+ * walk may or may not be reported, every other child is reported exactly
+ * once.
+ */
+static long child_walk_children(struct child_walk *walk)
+{
+	struct task_struct *task;
+
+	for_each_process(task)
+		if (rcu_access_pointer(task->real_parent) == current)
+			child_walk_visit(walk, task);
+	return 0;
+}
+
+/* The threads of walk->root, which must be looked up again on each walk */
+static long child_walk_threads(struct child_walk *walk)
+{
+	struct task_struct *leader, *task;
+
+	leader = walk->root ? find_task_by_vpid(walk->root) : current;
+	if (leader == NULL)
+		return -ESRCH;
+	for_each_thread(leader, task)
+		child_walk_visit(walk, task);
+	return 0;
+}
+
+static void child_walk_drop(struct child_walk *walk)
+{
+	size_t i;
+
+	if (walk->drop != NULL)
+		for (i = 0; i < min(walk->nb_children, walk->stage_nr); i++)
+			walk->drop((char *) walk->stage + i * walk->size);
+	child_pids_stage_free(walk->stage, walk->stage_nr * walk->size);
+	walk->stage = NULL;
+}
+
+/* Run the walk, staging up to want entries */
+static long child_walk_run(struct child_walk *walk, size_t want)
+{
+	u64 start;
+	long ret;
+
+	if (walk->iterate == NULL)
+		walk->iterate = child_walk_children;
+	walk->stage = NULL;
+	walk->stage_nr = 0;
+	if (want != 0)
+		walk->stage_nr = min_t(size_t, want, nr_processes() + CHILD_PIDS_STAGE_SLACK);
+retry:
+	if (walk->stage_nr != 0) {
+		walk->stage = child_pids_stage_alloc(walk->stage_nr * walk->size);
+		if (walk->stage == NULL)
+			return -ENOMEM;
+	}
+
+	walk->nb_children = 0;
+	trace_child_pids_walk_begin(walk->stage_nr);
+	start = hw1_latency_start();
+	rcu_read_lock();
+	ret = walk->iterate(walk);
+	rcu_read_unlock(); //leave the read side before copying out because put_user can sleep
+	hw1_latency_end(HW1_LATENCY_CHILD_WALK, start, ret);
+	trace_child_pids_walk_end(walk->nb_children);
+
+	if (ret != 0) {
+		child_walk_drop(walk);
+		return ret;
 	}
-	read_unlock(&tasklist_lock); //release lock before put_user because put_user can sleep -> avoid blocking
-	ret = put_user(nb_children, num_children); //(value, ptr)
+
+	//more children than the buffer was sized for, but still within want
+	if (walk->nb_children > walk->stage_nr && walk->stage_nr < want) {
+		child_walk_drop(walk);
+		walk->stage_nr = min_t(size_t, want, walk->nb_children + CHILD_PIDS_STAGE_SLACK);
+		goto retry;
+	}
+
+	return 0;
+}
+
+/*
+ * Hand the walk results to userspace with the get_child_pids contract:
+ * the child count goes to num_children, the first limit entries to list,
+ * and -ENOBUFS tells the caller they did not all fit. Frees the stage.
+ */
+static long child_walk_copy_out(struct child_walk *walk, void __user *list,
+				size_t limit, size_t __user *num_children)
+{
+	long ret;
+
+	ret = put_user(walk->nb_children, num_children); //(value, ptr)
+	if (ret == 0 && walk->stage != NULL &&
+	    copy_to_user(list, walk->stage,
+			 min3(walk->nb_children, walk->stage_nr, limit) * walk->size))
+		ret = -EFAULT;
+	child_pids_stage_free(walk->stage, walk->stage_nr * walk->size);
 	
 	if (ret != 0) {
-		return ret; // put_user return -EFAULT on error
+		return ret; // put_user and copy_to_user fail with -EFAULT
 	}
-	if (nb_children > limit) {
+	if (walk->nb_children > limit) {
 		ret = -ENOBUFS;
 	} else if (list == NULL && limit != 0) {
 		ret = -EFAULT;
 	}
 
-return ret;
+	return ret;
+}
+
+/*
+ * Count-only queries are answered from current->nr_children, kept up to
+ * date by sched_process_fork/exit probes instead of a walk. It counts the
+ * processes forked by a thread that have not exited yet and differs from
+ * what the walk reports in a few cases:
+ *  - it drops when the child exits, the walk reports zombies until they
+ *    are reaped;
+ *  - reparented children are not counted by their new parent, be it
+ *    another thread of the group, a subreaper or init;
+ *  - children forked before the probes were registered are not counted.
+ * Without CONFIG_TRACEPOINTS count-only queries walk like the others.
+ */
+static bool child_count_enabled;
+
+static void child_count_fork(void *data, struct task_struct *parent,
+			     struct task_struct *child)
+{
+	struct task_struct *real_parent;
+
+	//child is not running yet, and got a copy of its creator's counter
+	atomic_set(&child->nr_children, 0);
+	if (!thread_group_leader(child))
+		return;
+	rcu_read_lock();
+	real_parent = rcu_dereference(child->real_parent);
+	child->signal->nr_children_parent = real_parent; //new, zeroed signal_struct
+	atomic_inc(&real_parent->nr_children);
+	rcu_read_unlock();
+}
+
+static void child_count_exit(void *data, struct task_struct *task)
+{
+	struct task_struct *parent;
+
+	if (atomic_read(&task->signal->live) != 0)
+		return;
+	//the last threads of a group may exit concurrently, only one gets it
+	parent = xchg(&task->signal->nr_children_parent, NULL);
+	if (parent == NULL)
+		return;
+	rcu_read_lock();
+	//only compared: a parent that reparented us may be gone already
+	if (parent == rcu_dereference(task->real_parent))
+		atomic_dec(&parent->nr_children);
+	rcu_read_unlock();
+}
+
+static int __init child_count_init(void)
+{
+	if (register_trace_sched_process_fork(child_count_fork, NULL))
+		return 0;
+	if (register_trace_sched_process_exit(child_count_exit, NULL)) {
+		unregister_trace_sched_process_fork(child_count_fork, NULL);
+		return 0;
+	}
+	child_count_enabled = true;
+	return 0;
+}
+late_initcall(child_count_init);
+
+/* PIDs are reported as seen from the caller's namespace, like every input */
+static void child_fill_pid(void *entry, struct task_struct *task)
+{
+	*(pid_t *) entry = task_pid_vnr(task);
+}
+
+asmlinkage long sys_get_child_pids(pid_t* list, size_t limit,size_t* num_children) {
+	struct child_walk walk = {
+		.size = sizeof(pid_t),
+		.fill = child_fill_pid,
+	};
+	long ret;
+	u64 start;
+
+	trace_child_pids_enter(limit);
+	start = hw1_latency_start();
+
+	//limit == 0 is how callers ask for the count only
+	if ((list == NULL || limit == 0) && child_count_enabled) {
+		walk.nb_children = atomic_read(&current->nr_children);
+		ret = child_walk_copy_out(&walk, list, limit, num_children);
+	} else {
+		ret = child_walk_run(&walk, list != NULL ? limit : 0);
+		if (ret == 0)
+			ret = child_walk_copy_out(&walk, list, limit, num_children);
+	}
+
+	hw1_latency_end(HW1_LATENCY_CHILD_PIDS, start, ret);
+	trace_child_pids_exit(ret, walk.nb_children);
+	return ret;
+}
+
+/*
+ * List the thread IDs of the thread group of pid (0 for current) with
+ * the get_child_pids contract and copy-out: the thread count goes to
+ * *num_threads, the first limit TIDs to list, -ENOBUFS if they did not
+ * all fit. The group's thread list is walked under RCU.
+ */
+asmlinkage long sys_get_thread_tids(pid_t pid, pid_t __user *list, size_t limit,
+				    size_t __user *num_threads)
+{
+	struct child_walk walk = {
+		.size = sizeof(pid_t),
+		.iterate = child_walk_threads,
+		.fill = child_fill_pid,
+		.root = pid,
+	};
+	long ret;
+
+	ret = child_walk_run(&walk, list != NULL ? limit : 0);
+	if (ret != 0)
+		return ret;
+	return child_walk_copy_out(&walk, list, limit, num_threads);
+}
+
+static void child_fill_pid_ref(void *entry, struct task_struct *task)
+{
+	*(struct pid **) entry = get_pid(task_pid(task));
+}
+
+static void child_drop_pid_ref(void *entry)
+{
+	put_pid(*(struct pid **) entry);
+}
+
+/*
+ * Child handles: an anon inode fd pinning the struct pid of a child. The
+ * PID number of a reaped child can be recycled, the struct pid cannot, so
+ * a handle always refers to the process it was created for. read() gives
+ * its PID while it exists (zombies included) and fails with -ESRCH once
+ * it has been reaped. poll() reports POLLIN once the child has exited,
+ * that is when wait() would find it; it sleeps on the wait_chldexit queue
+ * of the process that created the handle, which exit_notify wakes.
+ */
+struct child_handle {
+	struct pid *pid;
+	struct task_struct *parent;	/* pins parent->signal */
+};
+
+static int child_handle_release(struct inode *inode, struct file *file)
+{
+	struct child_handle *handle = file->private_data;
+
+	put_pid(handle->pid);
+	put_task_struct(handle->parent);
+	kfree(handle);
+	return 0;
+}
+
+static ssize_t child_handle_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct child_handle *handle = file->private_data;
+	struct pid *pid = handle->pid;
+	pid_t nr = 0;
+
+	if (count < sizeof(pid_t))
+		return -EINVAL;
+
+	rcu_read_lock();
+	if (pid_task(pid, PIDTYPE_PID) != NULL)
+		nr = pid_vnr(pid);
+	rcu_read_unlock();
+	if (nr == 0)
+		return -ESRCH;
+
+	if (copy_to_user(buf, &nr, sizeof(nr)))
+		return -EFAULT;
+	return sizeof(nr);
+}
+
+static unsigned int child_handle_poll(struct file *file, poll_table *wait)
+{
+	struct child_handle *handle = file->private_data;
+	struct task_struct *task;
+	unsigned int mask = 0;
+
+	poll_wait(file, &handle->parent->signal->wait_chldexit, wait);
+
+	rcu_read_lock();
+	task = pid_task(handle->pid, PIDTYPE_PID);
+	//a zombie leader is only reported once its other threads are gone
+	if (task == NULL || (task->exit_state && thread_group_empty(task)))
+		mask = POLLIN | POLLRDNORM;
+	rcu_read_unlock();
+	return mask;
+}
+
+static void child_handle_show_fdinfo(struct seq_file *m, struct file *file)
+{
+	struct child_handle *handle = file->private_data;
+
+	seq_printf(m, "Pid:\t%d\n", pid_vnr(handle->pid));
+}
+
+static const struct file_operations child_handle_fops = {
+	.release	= child_handle_release,
+	.read		= child_handle_read,
+	.poll		= child_handle_poll,
+	.show_fdinfo	= child_handle_show_fdinfo,
+	.llseek		= noop_llseek,
+};
+
+/*
+ * Like sys_get_child_pids, but installs a child handle per child in the
+ * caller's fd table and returns the descriptors in fds. flags may hold
+ * O_CLOEXEC. Either every handle is installed or none is: on -ENOBUFS
+ * only the number of children is reported, so the caller can retry with a
+ * bigger array without closing anything.
+ */
+asmlinkage long sys_get_child_pidfds(int __user *fds, size_t limit,
+				     size_t __user *num_children, unsigned int flags)
+{
+	struct child_walk walk = {
+		.size = sizeof(struct pid *),
+		.fill = child_fill_pid_ref,
+		.drop = child_drop_pid_ref,
+	};
+	struct child_handle *handle;
+	struct file **files = NULL;
+	struct pid **refs;
+	int *nrs = NULL;
+	size_t nb, i, done = 0;
+	long ret;
+
+	if (flags & ~O_CLOEXEC)
+		return -EINVAL;
+
+	ret = child_walk_run(&walk, fds != NULL ? limit : 0);
+	if (ret != 0)
+		return ret;
+	refs = walk.stage;
+	nb = min(walk.nb_children, walk.stage_nr);
+
+	if (walk.nb_children > limit || (fds == NULL && limit != 0)) {
+		ret = put_user(walk.nb_children, num_children);
+		if (ret == 0)
+			ret = walk.nb_children > limit ? -ENOBUFS : -EFAULT;
+		goto out;
+	}
+
+	if (nb != 0) {
+		files = child_pids_stage_alloc(nb * sizeof(*files));
+		nrs = child_pids_stage_alloc(nb * sizeof(*nrs));
+		if (files == NULL || nrs == NULL) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	//reserve descriptors and files first, nothing is visible until fd_install
+	for (done = 0; done < nb; done++) {
+		nrs[done] = get_unused_fd_flags(flags);
+		if (nrs[done] < 0) {
+			ret = nrs[done];
+			goto out;
+		}
+		handle = kmalloc(sizeof(*handle), GFP_KERNEL);
+		if (handle == NULL) {
+			put_unused_fd(nrs[done]);
+			ret = -ENOMEM;
+			goto out;
+		}
+		handle->pid = refs[done];
+		handle->parent = current;
+		files[done] = anon_inode_getfile("[child_pid]", &child_handle_fops,
+						 handle, O_RDONLY);
+		if (IS_ERR(files[done])) {
+			put_unused_fd(nrs[done]);
+			kfree(handle);
+			ret = PTR_ERR(files[done]);
+			goto out;
+		}
+		get_task_struct(current);
+		refs[done] = NULL; //the file owns the reference now
+	}
+
+	ret = put_user(walk.nb_children, num_children);
+	if (ret == 0 && nb != 0 && copy_to_user(fds, nrs, nb * sizeof(*nrs)))
+		ret = -EFAULT;
+	if (ret != 0)
+		goto out;
+
+	for (i = 0; i < nb; i++)
+		fd_install(nrs[i], files[i]);
+	done = 0;
+out:
+	//on error, undo the reservations that were made
+	for (i = 0; i < done; i++) {
+		put_unused_fd(nrs[i]);
+		fput(files[i]);
+	}
+	for (i = 0; i < nb; i++)
+		if (refs[i] != NULL)
+			put_pid(refs[i]);
+	child_pids_stage_free(nrs, nb * sizeof(*nrs));
+	child_pids_stage_free(files, nb * sizeof(*files));
+	child_pids_stage_free(walk.stage, walk.stage_nr * walk.size);
+	return ret;
+}
+
+/*
+ * Everything a monitor used to scrape from /proc/<pid>/stat, read while
+ * the child is visited. Runs under rcu_read_lock, so nothing here sleeps.
+ */
+static void child_fill_info(void *entry, struct task_struct *task)
+{
+	struct child_info *info = entry;
+	struct mm_struct *mm;
+	cputime_t utime, stime;
+
+	info->pid = task_pid_vnr(task);
+	info->state = task->state | task->exit_state;
+	info->cpu = task_cpu(task);
+	info->nr_threads = get_nr_threads(task);
+
+	thread_group_cputime_adjusted(task, &utime, &stime);
+	info->utime = cputime_to_nsecs(utime);
+	info->stime = cputime_to_nsecs(stime);
+
+	info->rss = 0;
+	task_lock(task); //keeps task->mm from going away under us
+	mm = task->mm;
+	if (mm != NULL)
+		info->rss = get_mm_rss(mm);
+	task_unlock(task);
+}
+
+/*
+ * Like sys_get_child_pids, but fills a struct child_info per child:
+ * state, CPU, CPU times, thread count and RSS, collected in the same walk.
+ */
+asmlinkage long sys_get_child_info(struct child_info __user *list, size_t limit,
+				   size_t __user *num_children)
+{
+	struct child_walk walk = {
+		.size = sizeof(struct child_info),
+		.fill = child_fill_info,
+	};
+	long ret;
+
+	ret = child_walk_run(&walk, list != NULL ? limit : 0);
+	if (ret != 0)
+		return ret;
+
+	return child_walk_copy_out(&walk, list, limit, num_children);
+}
+
+static bool child_match_filter(struct task_struct *task, const void *arg)
+{
+	const struct child_filter *filter = arg;
+	char comm[TASK_COMM_LEN];
+	unsigned int state;
+
+	if (filter->state_mask != 0) {
+		if (task->exit_state & EXIT_ZOMBIE)
+			state = CHILD_FILTER_ZOMBIE;
+		else if (task->exit_state != 0)
+			state = 0; //being reaped, matches no state
+		else if (task->state == TASK_RUNNING)
+			state = CHILD_FILTER_RUNNING;
+		else if (task->state & TASK_INTERRUPTIBLE)
+			state = CHILD_FILTER_SLEEPING;
+		else if (task->state & TASK_UNINTERRUPTIBLE)
+			state = CHILD_FILTER_DISK;
+		else if (task->state & (__TASK_STOPPED | __TASK_TRACED))
+			state = CHILD_FILTER_STOPPED;
+		else
+			state = 0;
+		if (!(filter->state_mask & state))
+			return false;
+	}
+
+	if (task->real_start_time < filter->min_start_time)
+		return false;
+
+	if (filter->comm_prefix[0] != '\0') {
+		get_task_comm(comm, task);
+		if (strncmp(comm, filter->comm_prefix,
+			    strnlen(filter->comm_prefix, TASK_COMM_LEN)) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * sys_get_child_pids restricted to the children matching filter, applied
+ * during the walk: *num_children counts the matches only, so a caller
+ * interested in a few zombies does not pay for the whole family.
+ */
+asmlinkage long sys_get_child_pids_filter(pid_t __user *list, size_t limit,
+					  size_t __user *num_children,
+					  const struct child_filter __user *ufilter)
+{
+	struct child_filter filter;
+	struct child_walk walk = {
+		.size = sizeof(pid_t),
+		.fill = child_fill_pid,
+		.match = child_match_filter,
+		.arg = &filter,
+	};
+	long ret;
+
+	if (ufilter == NULL)
+		return -EFAULT;
+	if (copy_from_user(&filter, ufilter, sizeof(filter)))
+		return -EFAULT;
+	if (filter.state_mask & ~CHILD_FILTER_ALL)
+		return -EINVAL;
+
+	ret = child_walk_run(&walk, list != NULL ? limit : 0);
+	if (ret != 0)
+		return ret;
+
+	return child_walk_copy_out(&walk, list, limit, num_children);
+}
+
+/*
+ * Page through the children of current in PID order, limit at a time.
+ * *cursor is 0 for the first page and is updated to where the next call
+ * must resume; it is set to -1 once the whole PID space has been walked.
+ * Returns the number of PIDs written to list, which may be short, or
+ * even 0, before the end: loop until *cursor is -1.
+ *
+ * Like /proc readdir, the walk resumes with find_ge_pid() instead of
+ * rescanning from the start, and a cursor whose child has been reaped in
+ * the meantime stays valid. find_ge_pid() visits every PID of the
+ * namespace, not only children, so a call stops after
+ * CHILD_PIDS_CURSOR_SCAN of them: its cost, and the time spent in the
+ * RCU read side, are bounded by that and by limit.
+ */
+asmlinkage long sys_get_child_pids_cursor(pid_t __user *list, size_t limit,
+					  pid_t __user *cursor)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct task_struct *task;
+	struct pid *pid;
+	size_t nb_children = 0;
+	unsigned int scanned = 0;
+	pid_t *stage;
+	pid_t nr;
+	long ret;
+
+	if (list == NULL || cursor == NULL)
+		return -EFAULT;
+	if (limit == 0 || limit > CHILD_PIDS_PAGE_MAX)
+		return -EINVAL;
+	if (get_user(nr, cursor))
+		return -EFAULT;
+	if (nr == -1)
+		return 0; //already at the end
+	if (nr < 0)
+		return -EINVAL;
+
+	stage = child_pids_stage_alloc(limit * sizeof(pid_t));
+	if (stage == NULL)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	while (nb_children < limit && scanned < CHILD_PIDS_CURSOR_SCAN) {
+		pid = find_ge_pid(nr + 1, ns);
+		if (pid == NULL) {
+			nr = -1;
+			break;
+		}
+		scanned++;
+		nr = pid_nr_ns(pid, ns);
+		task = pid_task(pid, PIDTYPE_PID);
+		//threads of a child also have current as real_parent
+		if (task != NULL && thread_group_leader(task) &&
+		    rcu_access_pointer(task->real_parent) == current)
+			stage[nb_children++] = nr;
+	}
+	rcu_read_unlock();
+
+	ret = nb_children;
+	if (copy_to_user(list, stage, nb_children * sizeof(pid_t)))
+		ret = -EFAULT;
+	else if (put_user(nr, cursor))
+		ret = -EFAULT;
+	child_pids_stage_free(stage, limit * sizeof(pid_t));
+
+	return ret;
+}
+
+/* The parents of sys_get_child_pids_batch, sorted by task for lookups */
+struct child_tree_parent {
+	struct task_struct *task;
+	int index;
+};
+
+static int child_tree_parent_cmp(const void *a, const void *b)
+{
+	const struct task_struct *ta = ((const struct child_tree_parent *) a)->task;
+	const struct task_struct *tb = ((const struct child_tree_parent *) b)->task;
+
+	if (ta == tb)
+		return 0;
+	return ta < tb ? -1 : 1;
+}
+
+/*
+ * A process seen by sys_get_child_tree. Children are attached to the
+ * thread group leader of their real_parent, so the children forked by any
+ * thread of a process are found. The task pointers are only compared,
+ * never dereferenced, once the read side is left.
+ */
+struct child_tree_node {
+	struct task_struct *task;
+	struct task_struct *parent;
+	pid_t pid;
+};
+
+static int child_tree_node_cmp(const void *a, const void *b)
+{
+	const struct task_struct *pa = ((const struct child_tree_node *) a)->parent;
+	const struct task_struct *pb = ((const struct child_tree_node *) b)->parent;
+
+	if (pa == pb)
+		return 0;
+	return pa < pb ? -1 : 1;
+}
+
+/* First node whose parent is parent in nodes sorted by parent, or nb */
+static size_t child_tree_first(const struct child_tree_node *nodes, size_t nb,
+			       const struct task_struct *parent)
+{
+	size_t lo = 0, hi = nb, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (nodes[mid].parent < parent)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * Snapshot the descendant tree of pid (0 for current) in one call, as a
+ * BFS array of struct child_tree_entry. max_depth limits the levels below
+ * the root, 0 means no limit. Same contract as sys_get_child_pids:
+ * *num_entries gets the size of the whole tree, list the first limit
+ * entries, and -ENOBUFS is returned if they did not all fit.
+ *
+ * A single pass over the process list under RCU records every process
+ * with its parent; the BFS then runs over that array, sorted by parent,
+ * outside the read side and may reschedule.
+ */
+asmlinkage long sys_get_child_tree(pid_t pid, struct child_tree_entry __user *list,
+				   size_t limit, size_t __user *num_entries,
+				   unsigned int max_depth)
+{
+	struct child_walk walk = {
+		.size = sizeof(struct child_tree_entry),
+	};
+	struct child_tree_node *nodes = NULL;
+	struct child_tree_entry *entries;
+	struct task_struct **queue = NULL;
+	struct task_struct *task, *root;
+	size_t nb_nodes, nb_entries, i, j;
+	unsigned int depth;
+	size_t cap;
+	pid_t root_pid;
+
+	cap = nr_processes() + CHILD_PIDS_STAGE_SLACK;
+retry:
+	walk.stage_nr = cap;
+	walk.stage = child_pids_stage_alloc(cap * sizeof(*entries));
+	nodes = child_pids_stage_alloc(cap * sizeof(*nodes));
+	queue = child_pids_stage_alloc(cap * sizeof(*queue));
+	if (walk.stage == NULL || nodes == NULL || queue == NULL)
+		goto nomem;
+	entries = walk.stage;
+
+	nb_nodes = 0;
+	rcu_read_lock();
+	root = pid ? find_task_by_vpid(pid) : current;
+	if (root == NULL) {
+		rcu_read_unlock();
+		child_pids_stage_free(queue, cap * sizeof(*queue));
+		child_pids_stage_free(nodes, cap * sizeof(*nodes));
+		child_pids_stage_free(walk.stage, cap * sizeof(*entries));
+		return -ESRCH;
+	}
+	root = root->group_leader;
+	root_pid = task_pid_vnr(root);
+	for_each_process(task) {
+		if (nb_nodes < cap) {
+			nodes[nb_nodes].task = task;
+			nodes[nb_nodes].parent = rcu_dereference(task->real_parent)->group_leader;
+			nodes[nb_nodes].pid = task_pid_vnr(task);
+		}
+		nb_nodes++;
+	}
+	rcu_read_unlock();
+
+	if (nb_nodes > cap) {
+		//more processes than when we sized the buffers
+		child_pids_stage_free(queue, cap * sizeof(*queue));
+		child_pids_stage_free(nodes, cap * sizeof(*nodes));
+		child_pids_stage_free(walk.stage, cap * sizeof(*entries));
+		cap = nb_nodes + CHILD_PIDS_STAGE_SLACK;
+		goto retry;
+	}
+
+	sort(nodes, nb_nodes, sizeof(*nodes), child_tree_node_cmp, NULL);
+
+	queue[0] = root;
+	entries[0].pid = root_pid;
+	entries[0].parent_index = -1;
+	entries[0].depth = 0;
+	nb_entries = 1;
+	for (i = 0; i < nb_entries; i++) {
+		depth = entries[i].depth + 1;
+		if (max_depth != 0 && depth > max_depth)
+			continue;
+		for (j = child_tree_first(nodes, nb_nodes, queue[i]);
+		     j < nb_nodes && nodes[j].parent == queue[i]; j++) {
+			//parents read at different times could in theory loop
+			if (nb_entries == cap)
+				break;
+			queue[nb_entries] = nodes[j].task;
+			entries[nb_entries].pid = nodes[j].pid;
+			entries[nb_entries].parent_index = i;
+			entries[nb_entries].depth = depth;
+			nb_entries++;
+		}
+		cond_resched();
+	}
+	walk.nb_children = nb_entries;
+
+	child_pids_stage_free(queue, cap * sizeof(*queue));
+	child_pids_stage_free(nodes, cap * sizeof(*nodes));
+	return child_walk_copy_out(&walk, list, limit, num_entries);
+
+nomem:
+	child_pids_stage_free(queue, cap * sizeof(*queue));
+	child_pids_stage_free(nodes, cap * sizeof(*nodes));
+	child_pids_stage_free(walk.stage, cap * sizeof(*entries));
+	return -ENOMEM;
+}
+
+/* A child found by sys_get_child_pids_batch, before sorting by parent */
+struct child_batch_entry {
+	int parent_index;
+	pid_t pid;
+};
+
+/*
+ * Children of several parents in one call. parents holds nr_parents
+ * distinct PIDs, each of which the caller must be allowed to ptrace-read;
+ * a parent that has already gone away simply has no children, and the
+ * children forked by any thread of a parent are its children. The children are packed
+ * in list parent after parent: those of parents[i] are at
+ * list[offsets[i]] up to list[offsets[i + 1]], so offsets needs
+ * nr_parents + 1 entries and offsets[nr_parents] is the total. As with
+ * sys_get_child_pids, only the first limit PIDs are copied and -ENOBUFS
+ * tells the caller the total did not fit.
+ *
+ * All parents are served by one pass over the process list under a
+ * single RCU read side, looking the leader of each real_parent up in the
+ * sorted set.
+ */
+asmlinkage long sys_get_child_pids_batch(const pid_t __user *parents,
+					 size_t nr_parents, pid_t __user *list,
+					 size_t limit, size_t __user *offsets)
+{
+	struct child_walk walk = {
+		.size = sizeof(pid_t),
+	};
+	struct child_tree_parent *set = NULL;
+	struct child_batch_entry *stage = NULL;
+	struct task_struct **tasks = NULL;
+	struct child_tree_parent *hit;
+	struct task_struct *task, *leader = NULL;
+	size_t *counts = NULL;
+	pid_t *pids = NULL;
+	pid_t *out = NULL;
+	size_t nb_children = 0;
+	size_t nb_set = 0;
+	size_t cap = 0;
+	size_t i;
+	long ret = 0;
+
+	if (parents == NULL || offsets == NULL)
+		return -EFAULT;
+	if (nr_parents == 0 || nr_parents > CHILD_PIDS_BATCH_MAX)
+		return -EINVAL;
+
+	pids = child_pids_stage_alloc(nr_parents * sizeof(*pids));
+	tasks = child_pids_stage_alloc(nr_parents * sizeof(*tasks));
+	set = child_pids_stage_alloc(nr_parents * sizeof(*set));
+	counts = child_pids_stage_alloc((nr_parents + 1) * sizeof(*counts));
+	if (pids == NULL || tasks == NULL || set == NULL || counts == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	memset(tasks, 0, nr_parents * sizeof(*tasks));
+	if (copy_from_user(pids, parents, nr_parents * sizeof(*pids))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	//permission checks may sleep, do them before the walk
+	for (i = 0; i < nr_parents; i++) {
+		rcu_read_lock();
+		tasks[i] = find_task_by_vpid(pids[i]);
+		if (tasks[i] != NULL) {
+			get_task_struct(tasks[i]);
+			leader = tasks[i]->group_leader; //only compared
+		}
+		rcu_read_unlock();
+		if (tasks[i] == NULL)
+			continue;
+		if (!ptrace_may_access(tasks[i], PTRACE_MODE_READ)) {
+			ret = -EPERM;
+			goto out;
+		}
+		set[nb_set].task = leader;
+		set[nb_set].index = i;
+		nb_set++;
+	}
+	sort(set, nb_set, sizeof(*set), child_tree_parent_cmp, NULL);
+	//a process listed twice, maybe through two of its threads
+	for (i = 1; i < nb_set; i++) {
+		if (set[i].task == set[i - 1].task) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	cap = nr_processes() + CHILD_PIDS_STAGE_SLACK;
+retry:
+	stage = child_pids_stage_alloc(cap * sizeof(*stage));
+	if (stage == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	nb_children = 0;
+	rcu_read_lock();
+	for_each_process(task) {
+		struct child_tree_parent key = {
+			.task = rcu_dereference(task->real_parent)->group_leader,
+		};
+
+		hit = bsearch(&key, set, nb_set, sizeof(*set), child_tree_parent_cmp);
+		if (hit == NULL)
+			continue;
+		if (nb_children == cap) {
+			//more processes than when we sized the stage
+			rcu_read_unlock();
+			child_pids_stage_free(stage, cap * sizeof(*stage));
+			cap = nr_processes() + 2 * CHILD_PIDS_STAGE_SLACK;
+			goto retry;
+		}
+		stage[nb_children].parent_index = hit->index;
+		stage[nb_children].pid = task_pid_vnr(task);
+		nb_children++;
+	}
+	rcu_read_unlock();
+
+	//counting sort by parent: counts becomes the offsets array
+	memset(counts, 0, (nr_parents + 1) * sizeof(*counts));
+	for (i = 0; i < nb_children; i++)
+		counts[stage[i].parent_index + 1]++;
+	for (i = 0; i < nr_parents; i++)
+		counts[i + 1] += counts[i];
+	//offsets[nr_parents] is the total, child_walk_copy_out writes it
+	if (copy_to_user(offsets, counts, nr_parents * sizeof(*counts))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (limit != 0 && list != NULL && nb_children != 0) {
+		out = child_pids_stage_alloc(nb_children * sizeof(*out));
+		if (out == NULL) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		for (i = 0; i < nb_children; i++)
+			out[counts[stage[i].parent_index]++] = stage[i].pid;
+		walk.stage = out;
+		walk.stage_nr = nb_children;
+		out = NULL; //freed by child_walk_copy_out
+	}
+	walk.nb_children = nb_children;
+	ret = child_walk_copy_out(&walk, list, limit, &offsets[nr_parents]);
+out:
+	child_pids_stage_free(out, nb_children * sizeof(*out));
+	child_pids_stage_free(stage, cap * sizeof(*stage));
+	if (tasks != NULL)
+		for (i = 0; i < nr_parents; i++)
+			if (tasks[i] != NULL)
+				put_task_struct(tasks[i]);
+	child_pids_stage_free(counts, (nr_parents + 1) * sizeof(*counts));
+	child_pids_stage_free(set, nr_parents * sizeof(*set));
+	child_pids_stage_free(tasks, nr_parents * sizeof(*tasks));
+	child_pids_stage_free(pids, nr_parents * sizeof(*pids));
+	return ret;
 }
@@ -3,24 +3,368 @@
 #include <linux/kernel.h>  /* Needed for KERN_ALERT */
 #include <asm/atomic.h>
 #include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/timekeeping.h>
+#include <linux/math64.h>
+#include <linux/unique_id.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/hashtable.h>
+#include <linux/rculist.h>
+#include <linux/pid_namespace.h>
+#include <linux/workqueue.h>
+#include <linux/hw1_latency.h>
+#include <trace/events/hw1.h>
 
 #ifndef ATOMIC_VALUE 
 	#define ATOMIC_VALUE 1 
-	atomic_t v = ATOMIC_INIT(1);
+	atomic64_t v = ATOMIC64_INIT(1); //64 bits so the ID space never wraps
 #endif
 
+/* Largest block sys_get_unique_id_range hands out in one call */
+#define UNIQUE_ID_RANGE_MAX 65536
+
+/*
+ * Each CPU takes UNIQUE_ID_CHUNK IDs at a time from the global counter
+ * and serves the task blocks of sys_get_unique_id from them locally, so
+ * the shared cache line is only touched once per chunk. IDs stay unique
+ * but are no longer ordered across CPUs or tasks.
+ */
+#define UNIQUE_ID_CHUNK 1024
+/* IDs a task takes from the chunk at a time, divides UNIQUE_ID_CHUNK */
+#define UNIQUE_ID_TASK_BLOCK 16
+
+struct unique_id_chunk {
+	u64 next;	/* next ID to hand out */
+	u64 end;	/* one past the last ID of the chunk */
+};
+
+static DEFINE_PER_CPU(struct unique_id_chunk, unique_id_chunk);
+
+/* Take count <= UNIQUE_ID_CHUNK consecutive IDs from this CPU's chunk */
+static u64 unique_id_next(atomic64_t *counter,
+			  struct unique_id_chunk __percpu *chunks,
+			  unsigned int count)
+{
+	struct unique_id_chunk *chunk;
+	u64 id;
+
+	chunk = get_cpu_ptr(chunks); //disables preemption
+	if (chunk->end - chunk->next < count) {
+		chunk->end = atomic64_add_return(UNIQUE_ID_CHUNK, counter) + 1;
+		chunk->next = chunk->end - UNIQUE_ID_CHUNK;
+		trace_unique_id_refill(chunk->next, UNIQUE_ID_CHUNK);
+	}
+	id = chunk->next;
+	chunk->next += count;
+	put_cpu_ptr(chunks);
+
+	return id;
+}
+
+/*
+ * Every pid namespace but the initial one gets its own ID space: its own
+ * counter and per-CPU chunks, allocated on the first request from inside
+ * it. Containers then never share a cache line and cannot observe each
+ * other's allocation rate; IDs are only unique within a namespace. The
+ * initial namespace keeps using v and unique_id_chunk.
+ *
+ * struct pid_namespace is not touched: the spaces live in a hash table
+ * keyed by namespace, holding a reference on it. While the table is not
+ * empty a delayed work looks for namespaces whose processes are all gone
+ * every UNIQUE_ID_NS_REAP_INTERVAL and frees their spaces, which drops
+ * the last references on most of them.
+ */
+#define UNIQUE_ID_NS_HASH_BITS 6
+#define UNIQUE_ID_NS_REAP_INTERVAL (10 * HZ)
+
+struct unique_id_ns {
+	struct hlist_node node;		/* in unique_id_ns_table, under RCU */
+	struct list_head reap;
+	struct pid_namespace *ns;
+	atomic64_t counter;
+	struct unique_id_chunk __percpu *chunks;
+};
+
+static DEFINE_HASHTABLE(unique_id_ns_table, UNIQUE_ID_NS_HASH_BITS);
+static DEFINE_MUTEX(unique_id_ns_mutex); //only taken to add and reap spaces
+
+/* Called under rcu_read_lock or unique_id_ns_mutex */
+static struct unique_id_ns *unique_id_ns_find(struct pid_namespace *ns)
+{
+	struct unique_id_ns *space;
+
+	hash_for_each_possible_rcu(unique_id_ns_table, space, node, (unsigned long) ns)
+		if (space->ns == ns)
+			return space;
+	return NULL;
+}
+
+static void unique_id_ns_free(struct unique_id_ns *space)
+{
+	free_percpu(space->chunks);
+	put_pid_ns(space->ns);
+	kfree(space);
+}
+
+static void unique_id_ns_reap(struct work_struct *work)
+{
+	struct unique_id_ns *dead, *tmp;
+	struct hlist_node *next;
+	LIST_HEAD(reap);
+	int bkt;
+
+	mutex_lock(&unique_id_ns_mutex);
+	hash_for_each_safe(unique_id_ns_table, bkt, next, dead, node) {
+		//no process left and no PID can be allocated any more
+		if (ACCESS_ONCE(dead->ns->nr_hashed) == 0) {
+			hash_del_rcu(&dead->node);
+			list_add(&dead->reap, &reap);
+		}
+	}
+	if (!hash_empty(unique_id_ns_table))
+		schedule_delayed_work(to_delayed_work(work), UNIQUE_ID_NS_REAP_INTERVAL);
+	mutex_unlock(&unique_id_ns_mutex);
+
+	if (!list_empty(&reap)) {
+		synchronize_rcu();
+		list_for_each_entry_safe(dead, tmp, &reap, reap)
+			unique_id_ns_free(dead);
+	}
+}
+
+static DECLARE_DELAYED_WORK(unique_id_ns_reaper, unique_id_ns_reap);
+
+static int unique_id_ns_create(struct pid_namespace *ns)
+{
+	struct unique_id_ns *space;
+
+	space = kzalloc(sizeof(*space), GFP_KERNEL);
+	if (space == NULL)
+		return -ENOMEM;
+	space->chunks = alloc_percpu(struct unique_id_chunk);
+	if (space->chunks == NULL) {
+		kfree(space);
+		return -ENOMEM;
+	}
+	atomic64_set(&space->counter, 1);
+	space->ns = get_pid_ns(ns);
+
+	mutex_lock(&unique_id_ns_mutex);
+	if (unique_id_ns_find(ns) == NULL) {
+		hash_add_rcu(unique_id_ns_table, &space->node, (unsigned long) ns);
+		schedule_delayed_work(&unique_id_ns_reaper, UNIQUE_ID_NS_REAP_INTERVAL);
+		space = NULL;
+	}
+	mutex_unlock(&unique_id_ns_mutex);
+
+	if (space != NULL) //somebody else was faster
+		unique_id_ns_free(space);
+
+	return 0;
+}
+
+/*
+ * Take count IDs from the ID space of the caller's pid namespace, task
+ * blocks from the per-CPU chunk, bigger ones straight from the counter.
+ */
+static int unique_id_space_get(unsigned int count, u64 *first)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct unique_id_ns *space;
+	int ret;
+
+	if (ns == &init_pid_ns) {
+		if (count <= UNIQUE_ID_TASK_BLOCK)
+			*first = unique_id_next(&v, &unique_id_chunk, count);
+		else
+			*first = atomic64_add_return(count, &v) - count + 1;
+		return 0;
+	}
+
+	for (;;) {
+		rcu_read_lock();
+		space = unique_id_ns_find(ns);
+		if (space != NULL) {
+			if (count <= UNIQUE_ID_TASK_BLOCK)
+				*first = unique_id_next(&space->counter, space->chunks, count);
+			else
+				*first = atomic64_add_return(count, &space->counter) - count + 1;
+			rcu_read_unlock();
+			return 0;
+		}
+		rcu_read_unlock();
+
+		ret = unique_id_ns_create(ns);
+		if (ret != 0)
+			return ret;
+	}
+}
+
+/*
+ * Single IDs are served from a block of UNIQUE_ID_TASK_BLOCK IDs kept in
+ * the task itself, so a task only goes to the per-CPU chunk once every
+ * UNIQUE_ID_TASK_BLOCK calls and short lived processes mostly never do.
+ * The block is taken on the first call rather than at fork: a child
+ * starts with a copy of its parent's block and must not use it. IDs left
+ * in the block when the task exits are lost.
+ */
+static int unique_id_get(unsigned int count, u64 *first)
+{
+	struct unique_id_block *block = &current->unique_id_block;
+	int ret;
+
+	if (count != 1)
+		return unique_id_space_get(count, first);
+
+	if (block->owner != current ||
+	    block->owner_start_time != current->start_time ||
+	    block->next == block->end) {
+		ret = unique_id_space_get(UNIQUE_ID_TASK_BLOCK, &block->next);
+		if (ret != 0)
+			return ret;
+		block->end = block->next + UNIQUE_ID_TASK_BLOCK;
+		block->owner = current;
+		block->owner_start_time = current->start_time;
+	}
+	*first = block->next++;
+
+	return 0;
+}
+
+/*
+ * Snowflake IDs (UNIQUE_ID_SNOWFLAKE): time | CPU | sequence, built from
+ * per-CPU state only, so no cache line is shared between CPUs. IDs are
+ * k-sorted by time. They stay unique across reboots as long as the wall
+ * clock after boot is past the last millisecond used before; the per-CPU
+ * timestamp never goes backwards, and when the clock is stepped back or
+ * the 4096 sequence numbers of a millisecond run out, the next
+ * millisecond is borrowed instead.
+ */
+struct snowflake_state {
+	u64 last_ms;		/* ms since UNIQUE_ID_EPOCH_MS of the last ID */
+	unsigned int seq;	/* next sequence number within last_ms */
+};
+
+static DEFINE_PER_CPU(struct snowflake_state, snowflake_state);
+
+/*
+ * Reserve count consecutive snowflake IDs, count <= 1 << UNIQUE_ID_SEQ_BITS.
+ * The caller checks that every CPU number fits in UNIQUE_ID_CPU_BITS.
+ */
+static u64 snowflake_reserve(unsigned int count)
+{
+	struct snowflake_state *state;
+	u64 now_ms, id;
+
+	now_ms = div_u64(ktime_get_real_ns(), NSEC_PER_MSEC) - UNIQUE_ID_EPOCH_MS;
+
+	state = &get_cpu_var(snowflake_state); //disables preemption
+	if (now_ms > state->last_ms) {
+		state->last_ms = now_ms;
+		state->seq = 0;
+	} else if (state->seq + count > (1 << UNIQUE_ID_SEQ_BITS)) {
+		state->last_ms++;
+		state->seq = 0;
+	}
+	id = (state->last_ms << (UNIQUE_ID_CPU_BITS + UNIQUE_ID_SEQ_BITS)) |
+	     ((u64) smp_processor_id() << UNIQUE_ID_SEQ_BITS) | state->seq;
+	state->seq += count;
+	put_cpu_var(snowflake_state);
+
+	return id;
+}
+
+/*
+ * The int based calls share the 64 bit ID space: once it has grown past
+ * INT_MAX they fail with -EOVERFLOW instead of handing out wrapped,
+ * duplicate values. Callers that need more should use sys_get_unique_id64.
+ */
 asmlinkage long sys_get_unique_id(int *uuid)
 {
 	int ret = -EFAULT;
+	u64 id = 0;
+	u64 start;
+
+	trace_unique_id_enter(1);
+	start = hw1_latency_start();
 	if (uuid != (void *) 0){
-		atomic_inc(&v);
-		ret = put_user(atomic_read(&v), uuid);
+		ret = unique_id_get(1, &id);
+		if (ret == 0 && id > INT_MAX)
+			ret = -EOVERFLOW;
+		if (ret == 0)
+			ret = put_user((int) id, uuid);
 		//uuid is the destination address, in user space
-		//atomic_read(&v) is the value to copy to user_space
+		//id is the value to copy to user_space
 		//It copies a single value from kernel space to user_space
 		//Returns zero on success, or -EFAULT on error. 
 	}
+	hw1_latency_end(HW1_LATENCY_UNIQUE_ID, start, ret);
+	trace_unique_id_exit(ret, id);
 	
 	return ret;	
 }
 
+/*
+ * Reserve count consecutive IDs in one atomic operation.
+ * On success *base holds the first one, the caller owns
+ * [*base, *base + count - 1] and can hand them out without trapping.
+ */
+asmlinkage long sys_get_unique_id_range(int *base, unsigned int count)
+{
+	u64 first;
+	int ret;
+
+	if (base == (void *) 0)
+		return -EFAULT;
+	if (count == 0 || count > UNIQUE_ID_RANGE_MAX)
+		return -EINVAL;
+
+	ret = unique_id_get(count, &first);
+	if (ret != 0)
+		return ret;
+	if (first + count - 1 > INT_MAX)
+		return -EOVERFLOW;
+	return put_user((int) first, base);
+}
+
+/*
+ * 64 bit IDs. count == 1 is served from the task's block like
+ * sys_get_unique_id, larger counts reserve a contiguous block
+ * [*base, *base + count - 1]. This is the refill path of the userspace
+ * per-thread ID cache, which hands out the block without any kernel entry.
+ * With UNIQUE_ID_SNOWFLAKE in flags the IDs are time ordered snowflake IDs
+ * instead, at most 1 << UNIQUE_ID_SEQ_BITS per call; they are not offered
+ * (-EOPNOTSUPP) on machines with more CPUs than UNIQUE_ID_CPU_BITS covers.
+ */
+asmlinkage long sys_get_unique_id64(u64 __user *base, unsigned int count,
+				    unsigned int flags)
+{
+	u64 first;
+	int ret;
+
+	if (base == (void *) 0)
+		return -EFAULT;
+	if (flags & ~UNIQUE_ID_SNOWFLAKE)
+		return -EINVAL;
+	if (count == 0 || count > UNIQUE_ID_RANGE_MAX)
+		return -EINVAL;
+
+	if (flags & UNIQUE_ID_SNOWFLAKE) {
+		//CPU numbers would alias, and so would the IDs
+		if (nr_cpu_ids > (1 << UNIQUE_ID_CPU_BITS))
+			return -EOPNOTSUPP;
+		if (count > (1 << UNIQUE_ID_SEQ_BITS))
+			return -EINVAL;
+		first = snowflake_reserve(count);
+	} else {
+		ret = unique_id_get(count, &first);
+		if (ret != 0)
+			return ret;
+	}
+
+	if (copy_to_user(base, &first, sizeof(first)))
+		return -EFAULT;
+	return 0;
+}
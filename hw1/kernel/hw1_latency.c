@@ -0,0 +1,112 @@
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
+#include <linux/hw1_latency.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/hw1.h>
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Bucket i counts calls that took [2^(i-1), 2^i) ns, bucket 0 the ones
+ * under 1 ns and the last one everything from about 1 s up. Counters are
+ * per CPU so recording never shares a cache line; readers sum them and
+ * may see a call half recorded.
+ */
+#define HW1_LATENCY_BUCKETS	32
+
+struct hw1_latency_hist {
+	unsigned long count[HW1_LATENCY_BUCKETS];
+	unsigned long faults;	/* calls that returned -EFAULT */
+};
+
+static DEFINE_PER_CPU(struct hw1_latency_hist[HW1_LATENCY_NR], hw1_latency_hist);
+
+u32 hw1_latency_enabled;
+
+static const char * const hw1_latency_names[HW1_LATENCY_NR] = {
+	[HW1_LATENCY_UNIQUE_ID]		= "unique_id_latency",
+	[HW1_LATENCY_CHILD_PIDS]	= "child_pids_latency",
+	[HW1_LATENCY_CHILD_WALK]	= "child_walk_latency",
+};
+
+void hw1_latency_record(enum hw1_latency_site site, u64 ns, long ret)
+{
+	unsigned int bucket = min_t(unsigned int, fls64(ns), HW1_LATENCY_BUCKETS - 1);
+	struct hw1_latency_hist *hist = &get_cpu_var(hw1_latency_hist)[site];
+
+	hist->count[bucket]++;
+	if (ret == -EFAULT)
+		hist->faults++;
+	put_cpu_var(hw1_latency_hist);
+}
+
+static int hw1_latency_show(struct seq_file *m, void *v)
+{
+	enum hw1_latency_site site = (unsigned long) m->private;
+	unsigned long count, faults = 0;
+	int cpu, i;
+
+	seq_puts(m, "      ns from        count\n");
+	for (i = 0; i < HW1_LATENCY_BUCKETS; i++) {
+		count = 0;
+		for_each_possible_cpu(cpu)
+			count += per_cpu(hw1_latency_hist, cpu)[site].count[i];
+		if (count != 0)
+			seq_printf(m, "%13llu %12lu\n", i ? 1ULL << (i - 1) : 0ULL, count);
+	}
+	for_each_possible_cpu(cpu)
+		faults += per_cpu(hw1_latency_hist, cpu)[site].faults;
+	seq_printf(m, "faults %lu\n", faults);
+
+	return 0;
+}
+
+static int hw1_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hw1_latency_show, inode->i_private);
+}
+
+/* Any write clears the histogram */
+static ssize_t hw1_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	enum hw1_latency_site site = (unsigned long) m->private;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(hw1_latency_hist, cpu)[site], 0,
+		       sizeof(struct hw1_latency_hist));
+	return count;
+}
+
+static const struct file_operations hw1_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= hw1_latency_open,
+	.read		= seq_read,
+	.write		= hw1_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init hw1_latency_init(void)
+{
+	struct dentry *dir;
+	unsigned long site;
+
+	dir = debugfs_create_dir("hw1", NULL);
+	if (dir == NULL)
+		return -ENOMEM;
+	debugfs_create_bool("enable", 0644, dir, &hw1_latency_enabled);
+	for (site = 0; site < HW1_LATENCY_NR; site++)
+		debugfs_create_file(hw1_latency_names[site], 0644, dir,
+				    (void *) site, &hw1_latency_fops);
+	return 0;
+}
+late_initcall(hw1_latency_init);
+#endif /* CONFIG_DEBUG_FS */
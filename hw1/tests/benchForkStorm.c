@@ -0,0 +1,114 @@
+// Fork/exit storm next to a tight get_child_pids polling loop.
+// Forkers create and reap short-lived children as fast as they can while
+// a supervisor with NB_IDLE_CHILDREN children polls its child list. The
+// fork rate is measured without and then with the poller running, so the
+// same binary can be compared across kernels.
+// Usage: benchForkStorm [forkers] [seconds]
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#define __NR_get_child_pid 359
+
+#define NB_IDLE_CHILDREN 64
+
+static volatile long *fork_counts;
+static volatile int *stop;
+
+static void forker(int index) {
+	pid_t pid;
+
+	while (!*stop) {
+		pid = fork();
+		if (pid == 0)
+			_exit(0);
+		if (pid > 0) {
+			waitpid(pid, NULL, 0);
+			fork_counts[index]++;
+		}
+	}
+	_exit(0);
+}
+
+static void poller(void) {
+	pid_t idle[NB_IDLE_CHILDREN];
+	pid_t pid_list[NB_IDLE_CHILDREN];
+	size_t nr_children;
+	long polls = 0;
+	int i;
+
+	for (i = 0; i < NB_IDLE_CHILDREN; i++) {
+		idle[i] = fork();
+		if (idle[i] == 0) {
+			pause();
+			_exit(0);
+		}
+	}
+	while (!*stop) {
+		syscall(__NR_get_child_pid, pid_list, NB_IDLE_CHILDREN, &nr_children);
+		polls++;
+	}
+	for (i = 0; i < NB_IDLE_CHILDREN; i++) {
+		kill(idle[i], SIGKILL);
+		waitpid(idle[i], NULL, 0);
+	}
+	printf("  poller: %ld get_child_pids calls\n", polls);
+	_exit(0);
+}
+
+static double run(int nb_forkers, int seconds, int with_poller) {
+	pid_t pids[nb_forkers + 1];
+	long total = 0;
+	int i;
+
+	*stop = 0;
+	for (i = 0; i < nb_forkers; i++) {
+		fork_counts[i] = 0;
+		pids[i] = fork();
+		if (pids[i] == 0)
+			forker(i);
+	}
+	if (with_poller) {
+		pids[nb_forkers] = fork();
+		if (pids[nb_forkers] == 0)
+			poller();
+	}
+
+	sleep(seconds);
+	*stop = 1;
+
+	for (i = 0; i < nb_forkers + with_poller; i++)
+		waitpid(pids[i], NULL, 0);
+	for (i = 0; i < nb_forkers; i++)
+		total += fork_counts[i];
+
+	return (double) total / seconds;
+}
+
+int main(int argc, char **argv) {
+	int nb_forkers = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+	int seconds = argc > 2 ? atoi(argv[2]) : 5;
+	double alone, polled;
+	void *shared;
+
+	shared = mmap(NULL, (nb_forkers + 1) * sizeof(long), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		return 1;
+	stop = shared;
+	fork_counts = (long *) shared + 1;
+
+	printf("%d forkers, %d seconds per run\n", nb_forkers, seconds);
+	alone = run(nb_forkers, seconds, 0);
+	printf("  forks/s without poller: %.0f\n", alone);
+	polled = run(nb_forkers, seconds, 1);
+	printf("  forks/s with poller:    %.0f (%.1f%% of baseline)\n",
+	       polled, polled * 100 / alone);
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+// Per-call latency of get_unique_id and get_child_pids, reported as
+// percentiles in CSV so runs on two kernels can be diffed.
+//  - get_unique_id: 1, 2, 4, ... threads up to the CPU count, pinned to
+//    distinct CPUs and then left to the scheduler
+//  - get_child_pids: 1 to 100k idle children, limit large enough for all,
+//    then limit 0 to time the count-only query
+// Build: gcc -O2 -pthread benchSyscalls.c -o benchSyscalls
+// Usage: benchSyscalls [samples] [max_children]
+#define _GNU_SOURCE
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define __NR_get_unique_id 358
+#define __NR_get_child_pid 359
+
+static long nb_samples = 100000;
+static pthread_barrier_t barrier;
+
+struct worker {
+	pthread_t thread;
+	int cpu;		// -1 when not pinned
+	long *samples;		// ns per call
+};
+
+static long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int cmp_long(const void *a, const void *b) {
+	long x = *(const long *) a, y = *(const long *) b;
+	return (x > y) - (x < y);
+}
+
+static long percentile(long *sorted, long n, double p) {
+	long i = (long) (p * (n - 1));
+	return sorted[i];
+}
+
+static void report(const char *name, int threads, int pinned, long children,
+		   long *samples, long n) {
+	qsort(samples, n, sizeof(long), cmp_long);
+	printf("%s,%d,%d,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n", name, threads, pinned,
+	       children, n, percentile(samples, n, 0.50),
+	       percentile(samples, n, 0.90), percentile(samples, n, 0.99),
+	       percentile(samples, n, 0.999), samples[n - 1]);
+	fflush(stdout);
+}
+
+static void *unique_id_worker(void *arg) {
+	struct worker *w = arg;
+	cpu_set_t set;
+	long start, i;
+	int uuid;
+
+	if (w->cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(w->cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < nb_samples; i++) {
+		start = now_ns();
+		syscall(__NR_get_unique_id, &uuid);
+		w->samples[i] = now_ns() - start;
+	}
+	return NULL;
+}
+
+static void bench_unique_id(int threads, int pinned) {
+	struct worker workers[threads];
+	long *all = malloc(threads * nb_samples * sizeof(long));
+	int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+
+	pthread_barrier_init(&barrier, NULL, threads);
+	for (i = 0; i < threads; i++) {
+		workers[i].cpu = pinned ? i % ncpu : -1;
+		workers[i].samples = all + i * nb_samples;
+		pthread_create(&workers[i].thread, NULL, unique_id_worker, &workers[i]);
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	pthread_barrier_destroy(&barrier);
+
+	report("get_unique_id", threads, pinned, 0, all, threads * nb_samples);
+	free(all);
+}
+
+static void bench_child_pids(long nb_children) {
+	pid_t *children = malloc(nb_children * sizeof(pid_t));
+	pid_t *list = malloc(nb_children * sizeof(pid_t));
+	long *samples = malloc(nb_samples * sizeof(long));
+	long n = nb_samples, forked, start, i;
+	size_t nr_children;
+
+	for (forked = 0; forked < nb_children; forked++) {
+		children[forked] = fork();
+		if (children[forked] == 0) {
+			pause();
+			_exit(0);
+		}
+		if (children[forked] < 0)
+			break;
+	}
+
+	if (forked == nb_children) {
+		// big families are slow to walk, keep the run time bounded
+		if (nb_children >= 10000)
+			n = nb_samples / 100;
+		for (i = 0; i < n; i++) {
+			start = now_ns();
+			syscall(__NR_get_child_pid, list, nb_children, &nr_children);
+			samples[i] = now_ns() - start;
+		}
+		report("get_child_pids", 1, 0, nb_children, samples, n);
+		for (i = 0; i < n; i++) {
+			start = now_ns();
+			syscall(__NR_get_child_pid, NULL, 0, &nr_children);
+			samples[i] = now_ns() - start;
+		}
+		report("get_child_pids_count", 1, 0, nb_children, samples, n);
+	} else {
+		fprintf(stderr, "could only fork %ld of %ld children, skipping\n",
+			forked, nb_children);
+	}
+
+	for (i = 0; i < forked; i++)
+		kill(children[i], SIGKILL);
+	for (i = 0; i < forked; i++)
+		waitpid(children[i], NULL, 0);
+	free(samples);
+	free(list);
+	free(children);
+}
+
+int main(int argc, char **argv) {
+	int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	long max_children = 100000;
+	long children;
+	int threads;
+
+	if (argc > 1)
+		nb_samples = atol(argv[1]);
+	if (argc > 2)
+		max_children = atol(argv[2]);
+
+	printf("syscall,threads,pinned,children,samples,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+	for (threads = 1; threads <= ncpu; threads *= 2) {
+		bench_unique_id(threads, 1);
+		bench_unique_id(threads, 0);
+	}
+	for (children = 1; children <= max_children; children *= 10)
+		bench_child_pids(children);
+
+	return 0;
+}
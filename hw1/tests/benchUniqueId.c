@@ -0,0 +1,71 @@
+// Contention benchmark for get_unique_id: every thread calls the syscall
+// in a tight loop and we report the aggregate throughput per thread count.
+// Build: gcc -O2 -pthread benchUniqueId.c -o benchUniqueId
+#include <sys/syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define __NR_get_unique_id 358
+
+#define CALLS_PER_THREAD 200000
+
+static pthread_barrier_t barrier;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *worker(void *arg) {
+	int uuid;
+	int i;
+
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < CALLS_PER_THREAD; i++)
+		syscall(__NR_get_unique_id, &uuid);
+	pthread_barrier_wait(&barrier);
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t *threads;
+	double start, elapsed;
+	long nb_threads;
+	long i;
+
+	if (argc > 1)
+		max_threads = atol(argv[1]);
+	threads = malloc(max_threads * sizeof(*threads));
+	if (threads == NULL)
+		return 1;
+
+	printf("threads,calls,seconds,mcalls_per_sec,ns_per_call\n");
+	for (nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2) {
+		// the main thread joins both barriers to time the run
+		pthread_barrier_init(&barrier, NULL, nb_threads + 1);
+		for (i = 0; i < nb_threads; i++)
+			pthread_create(&threads[i], NULL, worker, NULL);
+
+		pthread_barrier_wait(&barrier);
+		start = now();
+		pthread_barrier_wait(&barrier);
+		elapsed = now() - start;
+
+		for (i = 0; i < nb_threads; i++)
+			pthread_join(threads[i], NULL);
+		pthread_barrier_destroy(&barrier);
+
+		printf("%ld,%ld,%f,%f,%.1f\n", nb_threads,
+		       nb_threads * CALLS_PER_THREAD, elapsed,
+		       nb_threads * CALLS_PER_THREAD / elapsed / 1e6,
+		       elapsed * 1e9 / CALLS_PER_THREAD);
+	}
+
+	free(threads);
+	return 0;
+}
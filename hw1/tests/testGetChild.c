@@ -2,9 +2,22 @@
 #include <stdio.h>
 #include <sys/syscall.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include "../include/uapi/linux/child_pids.h"
 
 
 #define __NR_get_child_pid 359
+#define __NR_get_child_pids_cursor 362
+#define __NR_get_child_tree 363
+#define __NR_get_child_info 364
+#define __NR_child_watch_open 365
+#define __NR_get_child_pids_filter 366
+#define __NR_get_child_pids_batch 367
+#define __NR_get_child_pidfds 368
 
 void print_list(pid_t* list, size_t limit) {
 	int i=0;
@@ -28,17 +41,117 @@ int main () {
 
 		// CASE : Arbitrary address for num_children
 		res = syscall(__NR_get_child_pid, pid_list, limit, (size_t*)47424742);
-		printf ( "Testing arbitrary address for num_children. Syscall returned %d \n", res);
+		printf ( "Testing arbitrary address for num_children. Syscall returned %ld \n", res);
 
 		// CASE : NULL pid_list, non initialized
 		res = syscall(__NR_get_child_pid, NULL, limit, &nr_children); 
-		printf ( "Testing NULL address for pids_list. Syscall returned %d \n", res);
+		printf ( "Testing NULL address for pids_list. Syscall returned %ld \n", res);
 
 		// CASE : Normal execution, num_children < limit
 		res= syscall(__NR_get_child_pid,pid_list, limit, &nr_children);
-		printf("Testing Nr_children = 3, limit = %d. Syscall returned %d , nr_children is %d\n", limit, res, nr_children);
+		printf("Testing Nr_children = 3, limit = %zu. Syscall returned %ld , nr_children is %zu\n", limit, res, nr_children);
 		printf("LIST OF CHILDREN PIDs syscall\n");
 		print_list(pid_list, (nr_children <= limit) ? nr_children : limit);
+
+		// CASE : Paging through the children one at a time
+		pid_t cursor = 0;
+		printf("PAGES OF CHILDREN PIDs, page size 1\n");
+		while (cursor != -1) {
+			res = syscall(__NR_get_child_pids_cursor, pid_list, 1, &cursor);
+			if (res < 0)
+				break;
+			if (res > 0)
+				printf("page: value %d, cursor is now %d\n", pid_list[0], cursor);
+		}
+		printf("Last page syscall returned %ld, cursor is %d\n", res, cursor);
+
+		// CASE : Zero sized page
+		res = syscall(__NR_get_child_pids_cursor, pid_list, 0, &cursor);
+		printf("Testing page size 0. Syscall returned %ld \n", res);
+
+		// CASE : Whole descendant tree in one call
+		struct child_tree_entry tree[16];
+		size_t nr_entries;
+		res = syscall(__NR_get_child_tree, 0, tree, 16, &nr_entries, 0);
+		printf("Testing descendant tree. Syscall returned %ld, nr_entries is %zu\n", res, nr_entries);
+		for (int i = 0; i < nr_entries && i < 16; i++)
+			printf("tree entry %d: pid %d parent_index %d depth %u\n",
+			       i, tree[i].pid, tree[i].parent_index, tree[i].depth);
+
+		// CASE : Tree limited to the direct children
+		res = syscall(__NR_get_child_tree, 0, tree, 16, &nr_entries, 1);
+		printf("Testing descendant tree, max_depth 1. Syscall returned %ld, nr_entries is %zu\n", res, nr_entries);
+
+		// CASE : Per-child records
+		struct child_info info[limit];
+		res = syscall(__NR_get_child_info, info, limit, &nr_children);
+		printf("Testing child info. Syscall returned %ld, nr_children is %zu\n", res, nr_children);
+		for (int i = 0; i < nr_children && i < limit; i++)
+			printf("child %d: state %u cpu %d threads %u utime %llu ns stime %llu ns rss %llu pages\n",
+			       info[i].pid, info[i].state, info[i].cpu, info[i].nr_threads,
+			       info[i].utime, info[i].stime, info[i].rss);
+
+		// CASE : Notifications for a child forked and reaped while watching
+		int watch_fd = syscall(__NR_child_watch_open, 0, O_NONBLOCK | O_CLOEXEC);
+		printf("Testing child watch. Syscall returned %d\n", watch_fd);
+		if (watch_fd >= 0) {
+			struct child_event events[8];
+			struct pollfd pfd = { .fd = watch_fd, .events = POLLIN };
+			pid_t pid = fork();
+			if (pid == 0)
+				_exit(0);
+			waitpid(pid, NULL, 0);
+			res = poll(&pfd, 1, 1000);
+			printf("poll returned %ld, revents %x\n", res, pfd.revents);
+			res = read(watch_fd, events, sizeof(events));
+			for (int i = 0; i < res / (int) sizeof(events[0]); i++)
+				printf("event: pid %d type %u\n", events[i].pid, events[i].type);
+			res = read(watch_fd, events, sizeof(events));
+			printf("Reading an empty watch returned %ld\n", res);
+			close(watch_fd);
+		}
+
+		// CASE : Only the running children named like us
+		struct child_filter filter = { .state_mask = CHILD_FILTER_RUNNING | CHILD_FILTER_SLEEPING };
+		strncpy(filter.comm_prefix, "testGet", sizeof(filter.comm_prefix));
+		res = syscall(__NR_get_child_pids_filter, pid_list, limit, &nr_children, &filter);
+		printf("Testing filter. Syscall returned %ld, nr_children is %zu\n", res, nr_children);
+		print_list(pid_list, (nr_children <= limit) ? nr_children : limit);
+
+		// CASE : Zombies only, there should be none
+		filter.state_mask = CHILD_FILTER_ZOMBIE;
+		res = syscall(__NR_get_child_pids_filter, pid_list, limit, &nr_children, &filter);
+		printf("Testing zombie filter. Syscall returned %ld, nr_children is %zu\n", res, nr_children);
+
+		// CASE : Children of ourselves and of our parent in one call
+		pid_t parents[2] = { getpid(), getppid() };
+		size_t offsets[3];
+		pid_t batch[32];
+		res = syscall(__NR_get_child_pids_batch, parents, 2, batch, 32, offsets);
+		printf("Testing batch. Syscall returned %ld, offsets %zu %zu %zu\n", res,
+		       offsets[0], offsets[1], offsets[2]);
+		for (int p = 0; p < 2; p++)
+			for (size_t i = offsets[p]; i < offsets[p + 1] && i < 32; i++)
+				printf("parent %d: child %d\n", parents[p], batch[i]);
+
+		// CASE : Handles instead of PIDs, nothing is installed on -ENOBUFS
+		int fds[limit];
+		res = syscall(__NR_get_child_pidfds, fds, limit, &nr_children, O_CLOEXEC);
+		printf("Testing child handles. Syscall returned %ld, nr_children is %zu\n", res, nr_children);
+
+		// CASE : Retry with room for every child
+		int all_fds[nr_children];
+		size_t nr_fds = nr_children;
+		res = syscall(__NR_get_child_pidfds, all_fds, nr_fds, &nr_children, O_CLOEXEC);
+		printf("Testing child handles again. Syscall returned %ld, nr_children is %zu\n", res, nr_children);
+		for (size_t i = 0; res == 0 && i < nr_children; i++) {
+			struct pollfd pfd = { .fd = all_fds[i], .events = POLLIN };
+			pid_t pid;
+			int n = read(all_fds[i], &pid, sizeof(pid));
+			printf("handle %d: read returned %d, pid %d, ", all_fds[i], n, pid);
+			printf("exited %d\n", poll(&pfd, 1, 0));
+			close(all_fds[i]);
+		}
 	}
 	
 	return 0;  
@@ -0,0 +1,105 @@
+// A/B run of libhw1: the same calls through the syscall and /proc backends.
+// Build: make -C ../tools/lib/hw1 && gcc -O2 testLibHw1.c -I../tools/lib/hw1 ../tools/lib/hw1/libhw1.a -pthread -o testLibHw1
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "hw1.h"
+
+#define NB_CHILDREN 3
+#define NB_IDS (1 << 20)
+#define NB_LISTS 1000
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(enum hw1_backend backend, const char *name) {
+	struct hw1_pids pids = {0};
+	uint64_t id, child_id;
+	pid_t child;
+	int fds[2];
+	double start;
+	size_t i;
+	int res;
+
+	if (hw1_set_backend(backend) != 0) {
+		perror("hw1_set_backend");
+		return;
+	}
+
+	res = hw1_get_unique_id(&id);
+	printf("%s: hw1_get_unique_id returned %d, id is %llu\n", name, res,
+	       (unsigned long long) id);
+	if (res != 0)
+		perror("hw1_get_unique_id");
+
+	// a forked child must not hand out the IDs left in the parent's block
+	if (res == 0 && pipe(fds) == 0) {
+		child = fork();
+		if (child == 0) {
+			if (hw1_get_unique_id(&id) != 0)
+				id = 0;
+			write(fds[1], &id, sizeof(id));
+			_exit(0);
+		}
+		hw1_get_unique_id(&id);
+		if (child < 0 || read(fds[0], &child_id, sizeof(child_id)) != sizeof(child_id))
+			child_id = 0;
+		printf("%s: after fork, parent id %llu, child id %llu: %s\n", name,
+		       (unsigned long long) id, (unsigned long long) child_id,
+		       child_id != 0 && child_id != id ? "ok" : "FAILED");
+		if (child > 0)
+			waitpid(child, NULL, 0);
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	res = hw1_get_child_pids(&pids);
+	printf("%s: hw1_get_child_pids returned %d, %zu children:", name, res, pids.nr);
+	for (i = 0; i < pids.nr; i++)
+		printf(" %d", pids.pids[i]);
+	printf("\n");
+	if (res != 0)
+		perror("hw1_get_child_pids");
+
+	start = now();
+	for (i = 0; i < NB_IDS; i++)
+		hw1_get_unique_id(&id);
+	printf("%s: %.1f ns/id\n", name, (now() - start) * 1e9 / NB_IDS);
+
+	start = now();
+	for (i = 0; i < NB_LISTS; i++)
+		hw1_get_child_pids(&pids);
+	printf("%s: %.1f us/list\n", name, (now() - start) * 1e6 / NB_LISTS);
+
+	hw1_pids_free(&pids);
+}
+
+int main(void) {
+	pid_t children[NB_CHILDREN];
+	int i;
+
+	for (i = 0; i < NB_CHILDREN; i++) {
+		children[i] = fork();
+		if (children[i] == 0) {
+			pause();
+			_exit(0);
+		}
+	}
+
+	printf("Default backend is %s\n",
+	       hw1_get_backend() == HW1_BACKEND_PROC ? "proc" : "syscall");
+	run(HW1_BACKEND_SYSCALL, "syscall");
+	run(HW1_BACKEND_PROC, "proc");
+
+	for (i = 0; i < NB_CHILDREN; i++)
+		kill(children[i], SIGKILL);
+	for (i = 0; i < NB_CHILDREN; i++)
+		waitpid(children[i], NULL, 0);
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include <sys/syscall.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define __NR_get_thread_tids 369
+
+#define NB_THREADS 4
+
+static pthread_barrier_t barrier;
+
+static void *worker(void *arg) {
+	pthread_barrier_wait(&barrier); // started
+	pthread_barrier_wait(&barrier); // main is done listing
+	return NULL;
+}
+
+int main(void) {
+	pthread_t threads[NB_THREADS];
+	pid_t tids[NB_THREADS + 1];
+	size_t nr_threads;
+	long res;
+	int i;
+
+	pthread_barrier_init(&barrier, NULL, NB_THREADS + 1);
+	for (i = 0; i < NB_THREADS; i++)
+		pthread_create(&threads[i], NULL, worker, NULL);
+	pthread_barrier_wait(&barrier);
+
+	// CASE : Normal execution, all threads fit
+	res = syscall(__NR_get_thread_tids, 0, tids, NB_THREADS + 1, &nr_threads);
+	printf("Testing %d threads. Syscall returned %ld, nr_threads is %zu\n",
+	       NB_THREADS + 1, res, nr_threads);
+	for (i = 0; i < nr_threads && i < NB_THREADS + 1; i++)
+		printf("tid %d: %d\n", i, tids[i]);
+
+	// CASE : Buffer too small
+	res = syscall(__NR_get_thread_tids, getpid(), tids, 2, &nr_threads);
+	printf("Testing limit 2. Syscall returned %ld, nr_threads is %zu\n", res, nr_threads);
+
+	// CASE : Count only
+	res = syscall(__NR_get_thread_tids, getpid(), NULL, 0, &nr_threads);
+	printf("Testing count only. Syscall returned %ld, nr_threads is %zu\n", res, nr_threads);
+
+	// CASE : Unknown pid
+	res = syscall(__NR_get_thread_tids, -2, tids, 2, &nr_threads);
+	printf("Testing unknown pid. Syscall returned %ld\n", res);
+
+	pthread_barrier_wait(&barrier);
+	for (i = 0; i < NB_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	return 0;
+}
@@ -1,13 +1,37 @@
+// Build: make -C ../tools/lib/hw1 && gcc -O2 testUniqueId.c -I../tools/lib/hw1 ../tools/lib/hw1/libhw1.a -pthread -o testUniqueId
+#define _GNU_SOURCE
+#include <sched.h>
 #include <sys/syscall.h>
+#include <sys/wait.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "hw1.h"
+#include "../include/uapi/linux/unique_id.h"
 
 #define __NR_get_unique_id 358
+#define __NR_get_unique_id_range 360
+#define __NR_get_unique_id64 361
+
+#define NB_IDS (1 << 20)
+#define RANGE_SIZE 4096
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
 int main(void) {
 	
     int uuid;
     int uuid2;
 	int res;
+	int base;
+	int i, j;
+	uint64_t id64;
+	long calls;
+	double start, elapsed;
 	
 	printf("First call\n"); fflush(stdout);
 	res = syscall(__NR_get_unique_id, (void *) 0);
@@ -22,6 +46,87 @@ int main(void) {
 	res = syscall(__NR_get_unique_id, &uuid2);
 	printf("Syscall returned %d, uuid is %d\n", res, uuid2);
 
+	printf("Range call, NULL base\n"); fflush(stdout);
+	res = syscall(__NR_get_unique_id_range, (void *) 0, RANGE_SIZE);
+	printf("Syscall returned %d\n", res);
+
+	printf("Range call, count 0\n"); fflush(stdout);
+	res = syscall(__NR_get_unique_id_range, &base, 0);
+	printf("Syscall returned %d\n", res);
+
+	printf("Range call, count %d\n", RANGE_SIZE); fflush(stdout);
+	res = syscall(__NR_get_unique_id_range, &base, RANGE_SIZE);
+	printf("Syscall returned %d, ids are [%d, %d]\n", res, base, base + RANGE_SIZE - 1);
+
+	printf("64 bit call, count 1\n"); fflush(stdout);
+	res = syscall(__NR_get_unique_id64, &id64, 1, 0);
+	printf("Syscall returned %d, id is %llu\n", res, (unsigned long long) id64);
+
+	printf("64 bit call, unknown flags\n"); fflush(stdout);
+	res = syscall(__NR_get_unique_id64, &id64, 1, 0x80);
+	printf("Syscall returned %d\n", res);
+
+	printf("Snowflake calls\n"); fflush(stdout);
+	for (i = 0; i < 3; i++) {
+		res = syscall(__NR_get_unique_id64, &id64, 1, UNIQUE_ID_SNOWFLAKE);
+		printf("Syscall returned %d, id is %llu: ms %llu cpu %llu seq %llu\n", res,
+		       (unsigned long long) id64,
+		       (unsigned long long) (id64 >> (UNIQUE_ID_CPU_BITS + UNIQUE_ID_SEQ_BITS)),
+		       (unsigned long long) (id64 >> UNIQUE_ID_SEQ_BITS) & ((1 << UNIQUE_ID_CPU_BITS) - 1),
+		       (unsigned long long) id64 & ((1 << UNIQUE_ID_SEQ_BITS) - 1));
+	}
+
+	// A new pid namespace starts its own ID space, whose first ID is 2 as in
+	// the initial one. Needs CAP_SYS_ADMIN
+	printf("New pid namespace\n"); fflush(stdout);
+	if (unshare(CLONE_NEWPID) != 0) {
+		perror("unshare");
+	} else if (fork() == 0) {
+		res = syscall(__NR_get_unique_id64, &id64, 1, 0);
+		printf("Syscall returned %d, first id in namespace is %llu\n", res,
+		       (unsigned long long) id64);
+		_exit(0);
+	} else {
+		wait(NULL);
+	}
+
+	// One syscall per ID
+	calls = 0;
+	start = now();
+	for (i = 0; i < NB_IDS; i++) {
+		syscall(__NR_get_unique_id, &uuid);
+		calls++;
+	}
+	elapsed = now() - start;
+	printf("get_unique_id:       %d ids, %ld calls, %f calls/id, %.1f ns/id\n",
+	       NB_IDS, calls, (double) calls / NB_IDS, elapsed * 1e9 / NB_IDS);
+
+	// One syscall per block, ids handed out in userspace
+	calls = 0;
+	start = now();
+	for (i = 0; i < NB_IDS; i += RANGE_SIZE) {
+		syscall(__NR_get_unique_id_range, &base, RANGE_SIZE);
+		calls++;
+		for (j = 0; j < RANGE_SIZE; j++)
+			uuid = base + j;
+	}
+	elapsed = now() - start;
+	printf("get_unique_id_range: %d ids, %ld calls, %f calls/id, %.1f ns/id\n",
+	       NB_IDS, calls, (double) calls / NB_IDS, elapsed * 1e9 / NB_IDS);
+
+	// Per-thread 64 bit cache of libhw1, the kernel is only entered to
+	// refill, once per HW1_ID_BLOCK IDs since this thread's cache is empty
+	if (hw1_set_backend(HW1_BACKEND_SYSCALL) != 0) {
+		perror("hw1_set_backend");
+		return 1;
+	}
+	calls = (NB_IDS + HW1_ID_BLOCK - 1) / HW1_ID_BLOCK;
+	start = now();
+	for (i = 0; i < NB_IDS; i++)
+		hw1_get_unique_id(&id64);
+	elapsed = now() - start;
+	printf("hw1_get_unique_id:   %d ids, %ld calls, %f calls/id, %.1f ns/id\n",
+	       NB_IDS, calls, (double) calls / NB_IDS, elapsed * 1e9 / NB_IDS);
 
 	return 0;
 }
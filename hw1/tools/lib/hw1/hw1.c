@@ -0,0 +1,272 @@
+// vim: noet:sts=8:ts=8:sw=8
+#define _GNU_SOURCE
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+#include "hw1.h"
+
+#define __NR_get_child_pid 359
+#define __NR_get_unique_id64 361
+
+// First guess for the children buffer
+#define HW1_PIDS_MIN 64
+
+struct hw1_ops {
+	int (*reserve_ids)(uint64_t *base, unsigned int count);
+	int (*child_pids)(struct hw1_pids *pids);
+};
+
+static const struct hw1_ops *hw1_ops;
+static pthread_once_t hw1_once = PTHREAD_ONCE_INIT;
+static unsigned int hw1_generation;	// bumped on every backend switch
+
+static __thread uint64_t id_next;
+static __thread uint64_t id_end;
+static __thread unsigned int id_generation;
+
+static int pids_reserve(struct hw1_pids *pids, size_t cap) {
+	pid_t *grown;
+
+	if (cap <= pids->cap)
+		return 0;
+	grown = realloc(pids->pids, cap * sizeof(pid_t));
+	if (grown == NULL)
+		return -1;
+	pids->pids = grown;
+	pids->cap = cap;
+	return 0;
+}
+
+static int pids_add(struct hw1_pids *pids, pid_t pid) {
+	if (pids->nr == pids->cap &&
+	    pids_reserve(pids, pids->cap ? 2 * pids->cap : HW1_PIDS_MIN) != 0)
+		return -1;
+	pids->pids[pids->nr++] = pid;
+	return 0;
+}
+
+/* Syscall backend */
+
+static int sys_reserve_ids(uint64_t *base, unsigned int count) {
+	return syscall(__NR_get_unique_id64, base, count, 0) < 0 ? -1 : 0;
+}
+
+static int sys_child_pids(struct hw1_pids *pids) {
+	size_t nr_children;
+
+	if (pids_reserve(pids, HW1_PIDS_MIN) != 0)
+		return -1;
+	// the count comes back with -ENOBUFS, grow to it plus some headroom
+	// for children forked in between and try again
+	while (syscall(__NR_get_child_pid, pids->pids, pids->cap, &nr_children) < 0) {
+		if (errno != ENOBUFS)
+			return -1;
+		if (pids_reserve(pids, nr_children + nr_children / 4 + 1) != 0)
+			return -1;
+	}
+	pids->nr = nr_children;
+	return 0;
+}
+
+static const struct hw1_ops hw1_syscall_ops = {
+	.reserve_ids = sys_reserve_ids,
+	.child_pids = sys_child_pids,
+};
+
+/* /proc backend */
+
+// Blocks come from a 64 bit counter in a file shared by all processes of
+// the user, updated under flock. The file is never followed through a
+// symlink, so nobody can point it at another file of ours.
+static int proc_reserve_ids(uint64_t *base, unsigned int count) {
+	const char *path = getenv("HW1_ID_FILE");
+	const char *dir;
+	char buf[4096];
+	uint64_t next = 1;
+	int fd, ret = -1;
+
+	if (path == NULL) {
+		dir = getenv("XDG_RUNTIME_DIR");
+		if (dir == NULL || *dir == '\0')
+			dir = getenv("HOME");
+		if (dir == NULL || *dir == '\0') {
+			errno = ENOENT;
+			return -1;
+		}
+		if (snprintf(buf, sizeof(buf), "%s/%s", dir, HW1_ID_FILE) >= (int) sizeof(buf)) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		path = buf;
+	}
+	fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+	if (flock(fd, LOCK_EX) != 0)
+		goto out;
+	if (pread(fd, &next, sizeof(next), 0) != sizeof(next))
+		next = 1; // new file
+	*base = next;
+	next += count;
+	if (pwrite(fd, &next, sizeof(next), 0) == sizeof(next))
+		ret = 0;
+out:
+	close(fd); // drops the lock
+	return ret;
+}
+
+// Children are listed in /proc/<pid>/task/<tid>/children, but only with
+// CONFIG_CHECKPOINT_RESTORE
+static int proc_children_file(struct hw1_pids *pids) {
+	char path[64];
+	FILE *f;
+	int pid;
+
+	snprintf(path, sizeof(path), "/proc/%d/task/%ld/children",
+		 getpid(), (long) syscall(SYS_gettid));
+	f = fopen(path, "re");
+	if (f == NULL)
+		return -1;
+	while (fscanf(f, "%d", &pid) == 1) {
+		if (pids_add(pids, pid) != 0) {
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+// Otherwise scan every /proc/<pid>/stat for the parent pid. That is the
+// parent process, so children of sibling threads are reported as well.
+static int proc_children_scan(struct hw1_pids *pids) {
+	char path[64], buf[512];
+	struct dirent *ent;
+	pid_t self = getpid();
+	char *p;
+	DIR *dir;
+	FILE *f;
+	int pid, ppid;
+
+	dir = opendir("/proc");
+	if (dir == NULL)
+		return -1;
+	while ((ent = readdir(dir)) != NULL) {
+		pid = atoi(ent->d_name);
+		if (pid <= 0)
+			continue;
+		snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+		f = fopen(path, "re");
+		if (f == NULL)
+			continue; // exited since readdir
+		p = fgets(buf, sizeof(buf), f);
+		fclose(f);
+		// "pid (comm) state ppid ...", comm may contain anything
+		if (p == NULL || (p = strrchr(buf, ')')) == NULL)
+			continue;
+		if (sscanf(p + 1, " %*c %d", &ppid) != 1 || ppid != self)
+			continue;
+		if (pids_add(pids, pid) != 0) {
+			closedir(dir);
+			return -1;
+		}
+	}
+	closedir(dir);
+	return 0;
+}
+
+static int proc_child_pids(struct hw1_pids *pids) {
+	pids->nr = 0;
+	if (proc_children_file(pids) == 0)
+		return 0;
+	pids->nr = 0;
+	return proc_children_scan(pids);
+}
+
+static const struct hw1_ops hw1_proc_ops = {
+	.reserve_ids = proc_reserve_ids,
+	.child_pids = proc_child_pids,
+};
+
+// The child of a fork gets a copy of the forking thread's block, which the
+// parent keeps using: drop it, the child reserves its own
+static void hw1_atfork_child(void) {
+	id_next = id_end;
+}
+
+static void hw1_init(void) {
+	const char *env = getenv("HW1_BACKEND");
+	uint64_t base;
+
+	pthread_atfork(NULL, NULL, hw1_atfork_child);
+
+	if (env != NULL && strcmp(env, "proc") == 0) {
+		hw1_ops = &hw1_proc_ops;
+	} else if (env != NULL && strcmp(env, "syscall") == 0) {
+		hw1_ops = &hw1_syscall_ops;
+	} else {
+		// probe with a block of one, a stock kernel answers ENOSYS
+		if (sys_reserve_ids(&base, 1) != 0 && errno == ENOSYS)
+			hw1_ops = &hw1_proc_ops;
+		else
+			hw1_ops = &hw1_syscall_ops;
+	}
+}
+
+int hw1_set_backend(enum hw1_backend backend) {
+	pthread_once(&hw1_once, hw1_init);
+	switch (backend) {
+	case HW1_BACKEND_SYSCALL:
+		__atomic_store_n(&hw1_ops, &hw1_syscall_ops, __ATOMIC_RELEASE);
+		break;
+	case HW1_BACKEND_PROC:
+		__atomic_store_n(&hw1_ops, &hw1_proc_ops, __ATOMIC_RELEASE);
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+	__atomic_add_fetch(&hw1_generation, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+enum hw1_backend hw1_get_backend(void) {
+	pthread_once(&hw1_once, hw1_init);
+	return __atomic_load_n(&hw1_ops, __ATOMIC_ACQUIRE) == &hw1_proc_ops ?
+		HW1_BACKEND_PROC : HW1_BACKEND_SYSCALL;
+}
+
+int hw1_get_unique_id(uint64_t *id) {
+	unsigned int generation = __atomic_load_n(&hw1_generation, __ATOMIC_ACQUIRE);
+	uint64_t base;
+
+	if (id_next == id_end || id_generation != generation) {
+		pthread_once(&hw1_once, hw1_init);
+		if (__atomic_load_n(&hw1_ops, __ATOMIC_ACQUIRE)->reserve_ids(&base, HW1_ID_BLOCK) != 0)
+			return -1;
+		id_next = base;
+		id_end = base + HW1_ID_BLOCK;
+		id_generation = generation;
+	}
+	*id = id_next++;
+	return 0;
+}
+
+int hw1_get_child_pids(struct hw1_pids *pids) {
+	pthread_once(&hw1_once, hw1_init);
+	return __atomic_load_n(&hw1_ops, __ATOMIC_ACQUIRE)->child_pids(pids);
+}
+
+void hw1_pids_free(struct hw1_pids *pids) {
+	free(pids->pids);
+	pids->pids = NULL;
+	pids->nr = 0;
+	pids->cap = 0;
+}
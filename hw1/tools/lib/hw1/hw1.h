@@ -0,0 +1,50 @@
+#ifndef _HW1_H
+#define _HW1_H
+
+// Client library for the hw1 syscalls. Two backends share one API:
+//  - HW1_BACKEND_SYSCALL: get_unique_id64 and get_child_pids
+//  - HW1_BACKEND_PROC: no custom syscall, IDs come from a counter file
+//    and children from /proc, for stock kernels and for A/B runs
+// The backend is picked once per process: HW1_BACKEND=proc or syscall in
+// the environment, otherwise the syscall one, falling back to /proc when
+// the kernel does not have the syscalls.
+// IDs are unique within a backend only, both count up from 1.
+// Functions return 0 on success, -1 with errno set on failure.
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+enum hw1_backend {
+	HW1_BACKEND_SYSCALL,
+	HW1_BACKEND_PROC,
+};
+
+// IDs a thread reserves at a time, then hands out without a kernel entry
+#define HW1_ID_BLOCK 4096
+
+// Counter file of the /proc backend, overridden by HW1_ID_FILE. It lives
+// in $XDG_RUNTIME_DIR, or $HOME without one, so it is private to the user
+#define HW1_ID_FILE "hw1_unique_id"
+
+// Children of the calling thread, pids[0..nr-1]. The buffer belongs to
+// the caller and is grown as needed: start from {0} and reuse it across
+// calls, release it with hw1_pids_free.
+struct hw1_pids {
+	pid_t *pids;
+	size_t nr;
+	size_t cap;
+};
+
+// Force a backend for the whole process, before or between calls.
+// Thread-local ID blocks taken from the other backend are dropped.
+int hw1_set_backend(enum hw1_backend backend);
+enum hw1_backend hw1_get_backend(void);
+
+// Next unique ID, from the calling thread's block
+int hw1_get_unique_id(uint64_t *id);
+
+// Fill pids with the current children, growing it on -ENOBUFS
+int hw1_get_child_pids(struct hw1_pids *pids);
+void hw1_pids_free(struct hw1_pids *pids);
+
+#endif /* _HW1_H */
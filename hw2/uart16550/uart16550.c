@@ -7,6 +7,11 @@
 #include <linux/kfifo.h>
 #include <linux/module.h>
 #include <linux/semaphore.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/atomic.h>
+#include <linux/timex.h>
+#include <linux/compat.h>
 #include "uart16550.h"
 #include "uart16550_hw.h"
 
@@ -22,214 +27,447 @@ __FILE__, __LINE__, ##__VA_ARGS__)
 
 static struct class *uart16550_class = NULL;
 
-const struct file_operations *fops;
-
 static int major = 42;
 static int behaviour = OPTION_BOTH;
 
+/*
+ * With threaded_irq the hard handler only moves bytes between the FIFOs
+ * and the rings; wakeups, line errors and statistics are left to the
+ * interrupt thread. threaded_irq=0 does it all in the hard handler, to
+ * compare the hard IRQ residency of both.
+ */
+static int threaded_irq = 1;
+
 module_param(major, int, S_IRUGO);
 module_param(behaviour, int, S_IRUGO);
+module_param(threaded_irq, int, S_IRUGO);
 
-struct cdev cdev1;
-struct cdev cdev2;
+/*
+ * Everything a port needs lives in its own struct, so COM1 and COM2
+ * share no state and never serialize against each other. The struct is
+ * found from the inode's cdev at open and handed to the interrupt
+ * handler as dev_id.
+ *
+ * One ring per direction. A kfifo with a single producer and a single
+ * consumer needs no lock: the interrupt handler is the only producer of
+ * inbuff and the only consumer of outbuff. On the process side inmutex
+ * and outmutex make readers, and writers, take turns, so each ring still
+ * has exactly one reader and one writer.
+ */
+struct uart16550_device {
+    uint32_t port;
+    int irq;
+    int minor;
+    const char *name;
+    int present;                        /* selected by behaviour */
+    struct cdev cdev;
 
-static int Device_Open = 0;
+    DECLARE_KFIFO(inbuff, uint8_t, FIFO_SIZE);
+    DECLARE_KFIFO(outbuff, uint8_t, FIFO_SIZE);
+    struct semaphore inmutex;
+    struct semaphore outmutex;
+    /*
+     * Readers sleep on inq until inbuff has data, writers on outq until
+     * outbuff has room; the interrupt handler wakes them.
+     */
+    wait_queue_head_t inq;
+    wait_queue_head_t outq;
 
-/*struct semaphore inmutex;
-struct semaphore outmutex;
-DEFINE_SEMAPHORE(inmutex);
-DEFINE_SEMAPHORE(outmutex);
+    /*
+     * What the hard handler did since the last report, taken over by
+     * uart16550_irq_report. The line status error bits are only read
+     * there and are cleared by the read, so they are counted right away.
+     */
+    atomic_t pending_rx;
+    atomic_t pending_tx;
+    atomic_t pending_dropped;
+    atomic_t pending_overruns;
+    atomic_t pending_parity_errors;
+    atomic_t pending_framing_errors;
 
-sema_init(&inmutex, 1);
-sema_init(&outmutex, 1);*/
+    /*
+     * Written by uart16550_irq_report, except interrupts and the
+     * hardirq_* residency counters, which only the hard handler writes.
+     */
+    struct uart16550_stats stats;
+};
 
-/*static struct kfifo inbuff;
-static struct kfifo outbuff;
-DECLARE_KFIFO(inbuff, char, FIFO_SIZE);
-DECLARE_KFIFO(outbuff, char, FIFO_SIZE);*/
+static struct uart16550_device devices[MAX_NUMBER_DEVICES] = {
+    {
+        .port = COM1_BASEPORT,
+        .irq = COM1_IRQ,
+        .minor = 0,
+        .name = "com1",
+    },
+    {
+        .port = COM2_BASEPORT,
+        .irq = COM2_IRQ,
+        .minor = 1,
+        .name = "com2",
+    },
+};
 
 static int uart16550_open (struct inode *inode, struct file *file){
-    // TODO
-    if (Device_Open) return -EBUSY;
-    Device_Open++;
-    
-    //MOD_INC_USE_COUNT;
+    struct uart16550_device *dev;
     
-    //inode->i_rdev = ;
+    dev = container_of(inode->i_cdev, struct uart16550_device, cdev);
+    file->private_data = dev;
     
     return 0;
 }
 
 static ssize_t uart16550_read (struct file *file, char __user *buffer, size_t length, loff_t *offset){
-    // TODO
-    int bytes_read = 0;
+    struct uart16550_device *dev = file->private_data;
+    unsigned int bytes_read = 0;
+    int ret;
     
-    //down_interruptible(&inmutex);
+    if (down_interruptible(&dev->inmutex))
+        return -ERESTARTSYS;
     
-    while (length && *buffer)  {
-        //put_user(kfifo_get(*inbuffer), buffer++);
-        
-        length--;
-        bytes_read++;
+    // sleep until there is something to read, unless O_NONBLOCK
+    while (kfifo_is_empty(&dev->inbuff)) {
+        up(&dev->inmutex);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(dev->inq, !kfifo_is_empty(&dev->inbuff)))
+            return -ERESTARTSYS;
+        if (down_interruptible(&dev->inmutex))
+            return -ERESTARTSYS;
     }
     
-    //up(&inmutex);
+    // takes what the interrupt handler has stored so far, up to length
+    ret = kfifo_to_user(&dev->inbuff, buffer, length, &bytes_read);
     
-    return bytes_read;
+    up(&dev->inmutex);
+    
+    return ret ? ret : bytes_read;
 }
 
 static int uart16550_release (struct inode *inode, struct file *file){
-    // TODO
-    Device_Open--;
-    
-    //MOD_DEC_USE_COUNT;
-    
     return 0;
 }
 
 static long uart16550_unlocked_ioctl (struct file *file, unsigned int cmd, unsigned long arg){
-    return 0;
+    struct uart16550_device *dev = file->private_data;
+    struct uart16550_line_info line;
+    
+    switch (cmd) {
+    case UART16550_IOCTL_SET_LINE:
+        if (copy_from_user(&line, (void __user *) arg, sizeof(line)))
+            return -EFAULT;
+        uart16550_hw_set_line_parameters(dev->port, line);
+        return 0;
+    case UART16550_IOCTL_GET_STATS:
+        if (copy_to_user((void __user *) arg, &dev->stats, sizeof(dev->stats)))
+            return -EFAULT;
+        return 0;
+    }
+    
+    return -ENOTTY;
 }
 
-static int uart16550_write(struct file *file, const char *user_buffer,
+#ifdef CONFIG_COMPAT
+/* Both ioctl arguments have the same layout for 32 bit callers */
+static long uart16550_compat_ioctl (struct file *file, unsigned int cmd, unsigned long arg){
+    return uart16550_unlocked_ioctl(file, cmd, (unsigned long) compat_ptr(arg));
+}
+#endif
+
+static ssize_t uart16550_write(struct file *file, const char __user *user_buffer,
                            size_t size, loff_t *offset)
 {
-    int bytes_copied = 0;
-    uint32_t device_port;
-    /*
-     * TODO: Write the code that takes the data provided by the
-     *      user from userspace and stores it in the kernel
-     *      device outgoing buffer.
-     * TODO: Populate bytes_copied with the number of bytes
-     *      that fit in the outgoing buffer.
-     */
+    struct uart16550_device *dev = file->private_data;
+    unsigned int bytes_copied = 0;
+    int ret;
     
-    uart16550_hw_force_interrupt_reemit(device_port);
+    if (down_interruptible(&dev->outmutex))
+        return -ERESTARTSYS;
+    
+    // sleep until there is room, unless O_NONBLOCK
+    while (kfifo_is_full(&dev->outbuff)) {
+        up(&dev->outmutex);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(dev->outq, !kfifo_is_full(&dev->outbuff)))
+            return -ERESTARTSYS;
+        if (down_interruptible(&dev->outmutex))
+            return -ERESTARTSYS;
+    }
+    
+    // only what fits in the outgoing buffer is taken
+    ret = kfifo_from_user(&dev->outbuff, user_buffer, size, &bytes_copied);
+    
+    up(&dev->outmutex);
+    
+    if (ret)
+        return ret;
+    
+    /* Get a THRE interrupt so the handler starts sending */
+    uart16550_hw_force_interrupt_reemit(dev->port);
     
     return bytes_copied;
 }
 
+/* Line status error bits, cleared by reading LSR */
+#define LSR_OVERRUN_ERROR   0x02
+#define LSR_PARITY_ERROR    0x04
+#define LSR_FRAMING_ERROR   0x08
+
+static int uart16550_irq_status(struct uart16550_device *dev)
+{
+    int device_status = uart16550_hw_get_device_status(dev->port);
+    
+    if (unlikely(device_status & (LSR_OVERRUN_ERROR | LSR_PARITY_ERROR | LSR_FRAMING_ERROR))) {
+        if (device_status & LSR_OVERRUN_ERROR)
+            atomic_inc(&dev->pending_overruns);
+        if (device_status & LSR_PARITY_ERROR)
+            atomic_inc(&dev->pending_parity_errors);
+        if (device_status & LSR_FRAMING_ERROR)
+            atomic_inc(&dev->pending_framing_errors);
+    }
+    
+    return device_status;
+}
+
+/* Wake up readers and writers and fold the pending counts into stats */
+static void uart16550_irq_report(struct uart16550_device *dev)
+{
+    int sent = atomic_xchg(&dev->pending_tx, 0);
+    int received = atomic_xchg(&dev->pending_rx, 0);
+    
+    dev->stats.tx_bytes += sent;
+    dev->stats.rx_bytes += received;
+    dev->stats.rx_dropped += atomic_xchg(&dev->pending_dropped, 0);
+    dev->stats.overruns += atomic_xchg(&dev->pending_overruns, 0);
+    dev->stats.parity_errors += atomic_xchg(&dev->pending_parity_errors, 0);
+    dev->stats.framing_errors += atomic_xchg(&dev->pending_framing_errors, 0);
+    
+    if (sent)
+        wake_up_interruptible(&dev->outq);
+    if (received)
+        wake_up_interruptible(&dev->inq);
+}
+
+/*
+ * Hard handler, data is the uart16550_device of the port. It is the
+ * producer of inbuff and the consumer of outbuff, so it never locks.
+ * IRQ_NONE when the port has nothing pending, so the core can tell the
+ * devices sharing the line apart and still detect spurious interrupts.
+ */
 irqreturn_t interrupt_handler(int irq_no, void *data)
 {
+    struct uart16550_device *dev = data;
     int device_status;
-    uint32_t device_port;
-    /*
-     * TODO: Write the code that handles a hardware interrupt.
-     * TODO: Populate device_port with the port of the correct device.
-     */
+    uint32_t device_port = dev->port;
+    int sent = 0, received = 0, dropped = 0;
+    cycles_t start, cycles;
     
-    device_status = uart16550_hw_get_device_status(device_port);
+    /* The line is shared, leave interrupts raised by other devices alone */
+    if (!uart16550_hw_interrupt_pending(device_port))
+        return IRQ_NONE;
     
-    while (uart16550_hw_device_can_send(device_status)) {
-        uint8_t byte_value;
-        /*
-         * TODO: Populate byte_value with the next value
-         *      from the kernel device outgoing buffer.
-         */
-        uart16550_hw_write_to_device(device_port, byte_value);
-        device_status = uart16550_hw_get_device_status(device_port);
+    start = get_cycles();
+    device_status = uart16550_irq_status(dev);
+    
+    /*
+     * THRE means the whole transmit FIFO is empty, so a full FIFO worth
+     * of bytes can go out back to back without looking at LSR again.
+     */
+    if (uart16550_hw_device_can_send(device_status)) {
+        uint8_t bytes[UART16550_TX_FIFO_DEPTH];
+        int i;
+        sent = kfifo_out(&dev->outbuff, bytes, UART16550_TX_FIFO_DEPTH);
+        for (i = 0; i < sent; i++)
+            uart16550_hw_write_to_device(device_port, bytes[i]);
+        if (sent)
+            device_status = uart16550_irq_status(dev);
     }
     
     while (uart16550_hw_device_has_data(device_status)) {
         uint8_t byte_value;
         byte_value = uart16550_hw_read_from_device(device_port);
-        /*
-         * TODO: Store the read byte_value in the kernel device
-         *      incoming buffer.
-         */
-        device_status = uart16550_hw_get_device_status(device_port);
+        // when the reader is too slow and the buffer is full the byte is lost
+        if (kfifo_put(&dev->inbuff, byte_value))
+            received++;
+        else
+            dropped++;
+        device_status = uart16550_irq_status(dev);
     }
     
+    atomic_add(sent, &dev->pending_tx);
+    atomic_add(received, &dev->pending_rx);
+    atomic_add(dropped, &dev->pending_dropped);
+    if (!threaded_irq)
+        uart16550_irq_report(dev);
+    
+    cycles = get_cycles() - start;
+    dev->stats.interrupts++;
+    dev->stats.hardirq_cycles += cycles;
+    if (cycles > dev->stats.hardirq_max_cycles)
+        dev->stats.hardirq_max_cycles = cycles;
+    
+    if (threaded_irq && (sent || received || dropped))
+        return IRQ_WAKE_THREAD;
     return IRQ_HANDLED;
 }
 
-static int uart16550_init(void)
+/* Interrupt thread, runs after the hard interrupts that moved bytes */
+irqreturn_t interrupt_thread(int irq_no, void *data)
 {
-    int have_com1, have_com2;
+    struct uart16550_device *dev = data;
+    
+    uart16550_irq_report(dev);
+    
+    return IRQ_HANDLED;
+}
 
-    if(behaviour == OPTION_COM1) {
-        have_com1 = 1;
-        have_com2 = 0;
-    }
-    else if(behaviour == OPTION_COM2) {
-        have_com1 = 0;
-        have_com2 = 1;
-    }
-    else if(behaviour == OPTION_BOTH) {
-        have_com1 = 1;
-        have_com2 = 1;
-    }
+static unsigned int uart16550_poll(struct file *file, poll_table *wait)
+{
+    struct uart16550_device *dev = file->private_data;
+    unsigned int mask = 0;
     
-    // initialize fops...
+    poll_wait(file, &dev->inq, wait);
+    poll_wait(file, &dev->outq, wait);
+    
+    if (!kfifo_is_empty(&dev->inbuff))
+        mask |= POLLIN | POLLRDNORM;
+    if (!kfifo_is_full(&dev->outbuff))
+        mask |= POLLOUT | POLLWRNORM;
+    
+    return mask;
+}
+
+static const struct file_operations uart16550_fops = {
+    .owner          = THIS_MODULE,
+    .open           = uart16550_open,
+    .read           = uart16550_read,
+    .write          = uart16550_write,
+    .poll           = uart16550_poll,
+    .release        = uart16550_release,
+    .unlocked_ioctl = uart16550_unlocked_ioctl,
+#ifdef CONFIG_COMPAT
+    .compat_ioctl   = uart16550_compat_ioctl,
+#endif
+};
+
+static int uart16550_setup(struct uart16550_device *dev)
+{
+    struct device *node;
+    int err;
+    
+    INIT_KFIFO(dev->inbuff);
+    INIT_KFIFO(dev->outbuff);
+    sema_init(&dev->inmutex, 1);
+    sema_init(&dev->outmutex, 1);
+    init_waitqueue_head(&dev->inq);
+    init_waitqueue_head(&dev->outq);
+    atomic_set(&dev->pending_rx, 0);
+    atomic_set(&dev->pending_tx, 0);
+    atomic_set(&dev->pending_dropped, 0);
+    atomic_set(&dev->pending_overruns, 0);
+    atomic_set(&dev->pending_parity_errors, 0);
+    atomic_set(&dev->pending_framing_errors, 0);
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    
+    /* The handler must be in place before the device interrupts */
+    err = request_threaded_irq(dev->irq, interrupt_handler,
+                               threaded_irq ? interrupt_thread : NULL,
+                               IRQF_SHARED, THIS_MODULE->name, dev);
+    if (err)
+        return err;
+    /* Setup the hardware device */
+    err = uart16550_hw_setup_device(dev->port, THIS_MODULE->name);
+    if (err)
+        goto fail_irq;
+    
+    cdev_init(&dev->cdev, &uart16550_fops);
+    dev->cdev.owner = THIS_MODULE;
+    err = cdev_add(&dev->cdev, MKDEV(major, dev->minor), 1);
+    if (err)
+        goto fail_hw;
+    /* Create the sysfs info for /dev/comX */
+    node = device_create(uart16550_class, NULL, MKDEV(major, dev->minor), NULL, dev->name);
+    if (IS_ERR(node)) {
+        err = PTR_ERR(node);
+        goto fail_cdev;
+    }
     
+    return 0;
+
+fail_cdev:
+    cdev_del(&dev->cdev);
+fail_hw:
+    uart16550_hw_cleanup_device(dev->port);
+fail_irq:
+    free_irq(dev->irq, dev);
+    return err;
+}
+
+static void uart16550_teardown(struct uart16550_device *dev)
+{
+    /* Reset the hardware device */
+    uart16550_hw_cleanup_device(dev->port);
+    free_irq(dev->irq, dev);
+    /* Remove the sysfs info for /dev/comX */
+    device_destroy(uart16550_class, MKDEV(major, dev->minor));
+    cdev_del(&dev->cdev);
+}
 
-    cdev_init(&cdev1, fops);
-    cdev1.owner = THIS_MODULE;
-    cdev_init(&cdev2, fops);
-    cdev2.owner = THIS_MODULE;
+static int uart16550_init(void)
+{
+    int i, err;
+
+    if (behaviour != OPTION_COM1 && behaviour != OPTION_COM2 &&
+        behaviour != OPTION_BOTH)
+        return -EINVAL;
+    devices[0].present = behaviour & UART16550_COM1_SELECTED;
+    devices[1].present = behaviour & UART16550_COM2_SELECTED;
+    
+    err = register_chrdev_region(MKDEV(major, 0), MAX_NUMBER_DEVICES, "uart16550");
+    if (err)
+        return err;
     
     /*
      * Setup a sysfs class & device to make /dev/com1 & /dev/com2 appear.
      */
     uart16550_class = class_create(THIS_MODULE, "uart16550");
-    
-    if (have_com1) {
-        cdev_add(&cdev1, 0, 1);
-        /* Setup the hardware device for COM1 */
-        uart16550_hw_setup_device(COM1_BASEPORT, THIS_MODULE->name);
-        /* Create the sysfs info for /dev/com1 */
-        device_create(uart16550_class, NULL, MKDEV(major, 0), NULL, "com1");
+    if (IS_ERR(uart16550_class)) {
+        err = PTR_ERR(uart16550_class);
+        unregister_chrdev_region(MKDEV(major, 0), MAX_NUMBER_DEVICES);
+        return err;
     }
-    if (have_com2) {
-        cdev_add(&cdev2, 1, 1);
-        /* Setup the hardware device for COM2 */
-        uart16550_hw_setup_device(COM2_BASEPORT, THIS_MODULE->name);
-        /* Create the sysfs info for /dev/com2 */
-        device_create(uart16550_class, NULL, MKDEV(major, 1), NULL, "com2");
-    }
-    if(have_com1 == 1 && have_com2 == 1){
+    
+    for (i = 0; i < MAX_NUMBER_DEVICES; i++) {
+        if (!devices[i].present)
+            continue;
+        err = uart16550_setup(&devices[i]);
+        if (err)
+            goto fail;
     }
     return 0;
+
+fail:
+    while (--i >= 0)
+        if (devices[i].present)
+            uart16550_teardown(&devices[i]);
+    class_destroy(uart16550_class);
+    unregister_chrdev_region(MKDEV(major, 0), MAX_NUMBER_DEVICES);
+    return err;
 }
 
 static void uart16550_cleanup(void)
 {
-    int have_com1, have_com2;
-    
-    if(behaviour == OPTION_COM1) {
-        have_com1 = 1;
-        have_com2 = 0;
-    }
-    else if(behaviour == OPTION_COM2) {
-        have_com1 = 0;
-        have_com2 = 1;
-    }
-    else if(behaviour == OPTION_BOTH) {
-        have_com1 = 1;
-        have_com2 = 1;
-    }
-    
-    if (have_com1) {
-        /* Reset the hardware device for COM1 */
-        uart16550_hw_cleanup_device(COM1_BASEPORT);
-        /* Remove the sysfs info for /dev/com1 */
-        device_destroy(uart16550_class, MKDEV(major, 0));
-    }
-    if (have_com2) {
-        /* Reset the hardware device for COM2 */
-        uart16550_hw_cleanup_device(COM2_BASEPORT);
-        /* Remove the sysfs info for /dev/com2 */
-        device_destroy(uart16550_class, MKDEV(major, 1));
-    }
+    int i;
     
-    cdev_del(&cdev1);
-    cdev_del(&cdev2);
+    for (i = 0; i < MAX_NUMBER_DEVICES; i++)
+        if (devices[i].present)
+            uart16550_teardown(&devices[i]);
     
     /*
      * Cleanup the sysfs device class.
      */
-    class_unregister(uart16550_class);
     class_destroy(uart16550_class);
+    unregister_chrdev_region(MKDEV(major, 0), MAX_NUMBER_DEVICES);
 }
 
 module_init(uart16550_init)
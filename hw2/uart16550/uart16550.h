@@ -1,6 +1,8 @@
 #ifndef _UART16550_H
 #define _UART16550_H
 
+#include <linux/types.h>
+
 #define OPTION_COM1                     1
 #define OPTION_COM2                     2
 #define OPTION_BOTH                     3
@@ -11,11 +13,26 @@
 #define MAX_NUMBER_DEVICES              2
 
 #define UART16550_IOCTL_SET_LINE        1
+#define UART16550_IOCTL_GET_STATS       2
 
 struct uart16550_line_info {
         unsigned char baud, len, par, stop;
 };
 
+/* Per-port counters, UART16550_IOCTL_GET_STATS; same layout for 32 bit callers */
+struct uart16550_stats {
+        __u64 rx_bytes;                 /* stored in the incoming buffer */
+        __u64 tx_bytes;                 /* written to the device */
+        __u64 rx_dropped;               /* lost, incoming buffer full */
+        __u64 interrupts;
+        __u64 overruns;                 /* lost, hardware FIFO full */
+        __u64 parity_errors;
+        __u64 framing_errors;
+        /* Time spent in the hard interrupt handler, in get_cycles() units */
+        __u64 hardirq_cycles;
+        __u64 hardirq_max_cycles;
+};
+
 
 #define COM1_BASEPORT                   0x3f8
 #define COM2_BASEPORT                   0x2f8
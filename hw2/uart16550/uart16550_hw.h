@@ -49,6 +49,9 @@
 #define MSR             0x06
 #define SCR             0x07
 
+/* Bytes the transmit FIFO holds, enabled by FCR in set_line_parameters */
+#define UART16550_TX_FIFO_DEPTH 16
+
 #define WRITE_TO_REG(port, reg, value)  outb(value, port + reg)
 #define READ_FROM_REG(port, reg)        inb(port + reg)
 
@@ -101,6 +104,12 @@ static inline int uart16550_hw_get_device_status(uint32_t port)
         return line_status;
 }
 
+/* IIR bit 0 is clear while the device has an interrupt pending */
+static inline int uart16550_hw_interrupt_pending(uint32_t port)
+{
+        return !(READ_FROM_REG(port, ISR) & 0x01);
+}
+
 static inline int uart16550_hw_device_can_send(int device_status)
 {
         return device_status & 0x20;